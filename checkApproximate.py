@@ -0,0 +1,85 @@
+# checks the approximate mode of pageReadWriteSummary against the exact mode
+# Generates traces with private and shared read only and written pages for
+# several thread counts, runs pageReadWriteSummary and
+# pageReadWriteSummary -p N on them for every precision and compares the
+# page counts of every time frame.
+# Takes optional inputs
+# [precision ...] (default 10 12 14)
+# Exits with 1 if the worst relative error of a column in any frame exceeds
+# the bound given in the documentation.
+
+from __future__ import print_function
+import sys, random, subprocess
+
+threadCounts = [4, 8, 16, 32]
+frames = 10
+accessesPerThread = 6000
+seed = 1
+
+# pool sizes per thread and frame, the shared pools grow with the threads
+privateReadPages = 600
+privateWritePages = 400
+sharedReadPages = 400
+sharedWritePages = 200
+
+# documented bound of the worst relative error of a frame per precision,
+# for every thread count
+# Pages Read, Pages Written, Private Read Only, Shared Read Only, Private Write, Shared Write
+bounds = {
+	10: [0.15, 0.15, 0.30, 0.30, 0.20, 0.25],
+	12: [0.05, 0.05, 0.08, 0.12, 0.08, 0.10],
+	14: [0.03, 0.03, 0.04, 0.06, 0.04, 0.05],
+}
+
+columns = ["Pages Read", "Pages Written", "Private Read Only", "Shared Read Only", "Private Write", "Shared Write"]
+
+def generateTrace(threads):
+	random.seed(seed)
+	lines = []
+	for t in range(threads):
+		lines.append("%d\t-1\t-1\t-1" % t)
+		for f in range(frames):
+			lines.append("%d\t%d\t0\t-1" % (t % 4, f))
+			base = (f + 1) * 10**8
+			for i in range(accessesPerThread):
+				r = random.random()
+				if r < 0.3:
+					page, write = base + t * 10**5 + random.randrange(privateReadPages), 0
+				elif r < 0.5:
+					page, write = base + t * 10**5 + 50000 + random.randrange(privateWritePages), 1
+				elif r < 0.8:
+					page, write = base + 9 * 10**7 + random.randrange(sharedReadPages * threads), 0
+				else:
+					page, write = base + 9 * 10**7 + 10**6 + random.randrange(sharedWritePages * threads), random.random() < 0.5
+				lines.append("%d\t%d\t%d\t%d" % (page, t % 4, 1 - write, write))
+	return "\n".join(lines) + "\n"
+
+def summarize(trace, options):
+	process = subprocess.Popen(["./pageReadWriteSummary"] + options, stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+	output = process.communicate(trace.encode())[0].decode()
+	rows = {}
+	for line in output.splitlines()[1:]:
+		values = [int(x) for x in line.split("\t")]
+		rows[values[0]] = values[1:]
+	return rows
+
+precisions = [int(p) for p in sys.argv[1:]] or [10, 12, 14]
+
+failed = False
+print("threads\tprecision\t" + "\t".join(columns))
+for threads in threadCounts:
+	trace = generateTrace(threads)
+	exact = summarize(trace, [])
+	for precision in precisions:
+		approximate = summarize(trace, ["-p", str(precision)])
+		errors = []
+		for c in range(len(columns)):
+			errors.append(max(abs(approximate[f][c] - exact[f][c]) / float(exact[f][c]) for f in exact if exact[f][c] > 0))
+		print("%d\t%d\t" % (threads, precision) + "\t".join("%.3f" % e for e in errors))
+		if precision in bounds:
+			for c in range(len(columns)):
+				if errors[c] > bounds[precision][c]:
+					print("%s with %d threads at precision %d exceeds %.3f" % (columns[c], threads, precision, bounds[precision][c]), file=sys.stderr)
+					failed = True
+
+sys.exit(1 if failed else 0)
@@ -0,0 +1,61 @@
+# checks the regression gate of traceDiff
+# Writes summarizeInterconnect and pageReadWriteSummary outputs of two runs
+# to temporary files, runs traceDiff on them and checks the exit status and
+# the flags of the total row. A run spreading the same accesses over more
+# frames with the same pages per frame must not regress, doubled remote
+# traffic or shared pages must.
+# Exits with 1 if a case fails.
+
+from __future__ import print_function
+import sys, os, shutil, subprocess, tempfile
+
+nodes = 2
+
+# accesses of the whole run, spread evenly over its frames
+localAccesses = 10000
+
+def writeRun(directory, name, frames, remote, shared):
+	interconnect = os.path.join(directory, name + ".nodes")
+	pages = os.path.join(directory, name + ".pages")
+	f = open(interconnect, "w")
+	f.write("frame\tsourceNode\tdestNode\treads\twrites\n")
+	for frame in range(frames):
+		for source in range(nodes):
+			for dest in range(nodes):
+				reads = (remote if source != dest else localAccesses) // frames
+				f.write("%d\t%d\t%d\t%d\t%d\n" % (frame, source, dest, reads, reads // 2))
+	f.close()
+	f = open(pages, "w")
+	f.write("Time Frame\tPages Read\tPages Written\tPrivate Read Only\tShared Read Only\tPrivate Write\tShared Write\n")
+	for frame in range(frames):
+		f.write("%d\t%d\t50\t40\t%d\t40\t%d\n" % (frame, 80 + 2 * shared, shared, shared))
+	f.close()
+	return interconnect, pages
+
+def traceDiff(before, after, options):
+	process = subprocess.Popen(["./traceDiff"] + options + ["--pages", before[1], after[1], before[0], after[0]],
+	                           stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+	output = process.communicate()[0].decode()
+	total = output.splitlines()[-1].split("\t")
+	return process.returncode, total[-1]
+
+# name, frames before, frames after, remote accesses after, shared pages per frame after, expected exit status, expected flags
+cases = [
+	("different length", 10, 15, 1000, 10, 0, "-"),
+	("shared pages doubled", 10, 10, 1000, 20, 1, "sharedPages"),
+	("remote traffic doubled", 10, 10, 2000, 10, 1, "remoteRatio,remoteTraffic"),
+]
+
+failed = False
+directory = tempfile.mkdtemp()
+for name, beforeFrames, afterFrames, remote, shared, status, flags in cases:
+	before = writeRun(directory, "before", beforeFrames, 1000, 10)
+	after = writeRun(directory, "after", afterFrames, remote, shared)
+	for align in ["window", "progress"]:
+		code, totalFlags = traceDiff(before, after, ["--align", align])
+		ok = code == status and totalFlags == flags
+		print("%s\t%s\t%d\t%s\t%s" % (name, align, code, totalFlags, "ok" if ok else "FAILED"))
+		failed = failed or not ok
+shutil.rmtree(directory)
+
+sys.exit(1 if failed else 0)
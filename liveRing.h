@@ -0,0 +1,97 @@
+/*
+ * liveRing.h
+ * Layout of the shared memory ring numatrace publishes per time
+ * window aggregates to when run with -live, and numamonitor reads.
+ *
+ * numatrace is the only writer. Each slot is protected by a sequence
+ * counter that is odd while the slot is written; a reader copies the
+ * slot and retries if the counter was odd or changed during the copy,
+ * so the reader never blocks the traced process. published counts
+ * the windows written so far, the newest window is in slot
+ * (published - 1) % LIVE_RING_SLOTS.
+ *
+ * numatrace replaces any ring left behind under the same name when
+ * it starts and unlinks the ring when the program exits. pid lets a
+ * reader recognize a ring whose writer died without finishing.
+ */
+#ifndef LIVE_RING_H
+#define LIVE_RING_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define LIVE_RING_MAGIC 0x4e554d41
+#define LIVE_RING_VERSION 2
+#define LIVE_RING_SLOTS 64
+#define LIVE_MAX_NODES 16
+#define LIVE_MAX_THREADS 64
+
+struct liveReadWrite_t {
+    uint64_t reads;
+    uint64_t writes;
+};
+
+struct liveWindow_t {
+    uint64_t sequence;
+    int64_t window;                 // time window since start of the program
+    uint64_t distinctPages;         // approximate, from a HyperLogLog sketch
+    uint32_t numNodes;
+    uint32_t numThreads;            // highest thread id seen + 1, at most LIVE_MAX_THREADS
+    liveReadWrite_t nodes[LIVE_MAX_NODES][LIVE_MAX_NODES];  // [sourceNode][destNode]
+    liveReadWrite_t threads[LIVE_MAX_THREADS];
+};
+
+struct liveRing_t {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t windowLength;          // in microseconds
+    uint32_t finished;              // set when the traced program exits
+    uint32_t pid;                   // process id of the traced program
+    uint64_t published;
+    liveWindow_t slots[LIVE_RING_SLOTS];
+};
+
+/*
+ * Copies window into the next slot of the ring. Must not be called
+ * concurrently.
+ */
+static inline void liveRingPublish(liveRing_t* ring, const liveWindow_t* window) {
+    uint64_t published = ring->published;
+    liveWindow_t* slot = &ring->slots[published % LIVE_RING_SLOTS];
+    uint64_t sequence = slot->sequence;
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((char*)slot + sizeof(slot->sequence), (const char*)window + sizeof(window->sequence),
+	   sizeof(liveWindow_t) - sizeof(slot->sequence));
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->published, published + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Copies the window published as number index (0 based) out of the
+ * ring. Returns false if the slot has been overwritten by a later
+ * window in the meantime. The sequence of a slot grows by 2 per
+ * window, so the copy of window index is valid only if the sequence
+ * was 2 * (index / LIVE_RING_SLOTS + 1) before and after the copy.
+ */
+static inline bool liveRingRead(const liveRing_t* ring, uint64_t index, liveWindow_t* window) {
+    const liveWindow_t* slot = &ring->slots[index % LIVE_RING_SLOTS];
+    uint64_t expected = 2 * (index / LIVE_RING_SLOTS + 1);
+    for (;;) {
+	uint64_t before = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+	if (before > expected) {
+	    return false;
+	}
+	if (before != expected) {
+	    // window index is still being written
+	    continue;
+	}
+	memcpy(window, slot, sizeof(liveWindow_t));
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == before) {
+	    return true;
+	}
+    }
+}
+
+#endif
@@ -0,0 +1,242 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <deque>
+
+#include "liveRing.h"
+
+
+#define DEFAULT_INTERVAL_mS 500
+#define DEFAULT_HISTORY 10
+
+
+using namespace std;
+
+int interval(DEFAULT_INTERVAL_mS);
+uint historyLength(DEFAULT_HISTORY);
+deque<liveWindow_t> history;
+ino_t ringInode(0);
+
+
+string shmName(const string& name) {
+    return (name[0] == '/') ? name : "/" + name;
+}
+
+/**
+ * @return the inode of the ring currently published under name, 0 if there is none
+ */
+ino_t currentInode(const string& name) {
+    int fd = shm_open(shmName(name).c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+	return 0;
+    }
+    struct stat status;
+    ino_t inode = (fstat(fd, &status) == 0) ? status.st_ino : 0;
+    close(fd);
+    return inode;
+}
+
+bool writerExited(const liveRing_t* ring) {
+    return kill(ring->pid, 0) != 0 && errno == ESRCH;
+}
+
+/**
+ * Maps the ring numatrace -live name publishes to, waiting until
+ * the traced program has created it. A ring whose program has
+ * already exited is left over from an earlier run and skipped
+ * until a new run replaces it.
+ */
+const liveRing_t* openRing(const string& name) {
+    ino_t staleInode = 0;
+    for (;; usleep(interval * 1000)) {
+	int fd = shm_open(shmName(name).c_str(), O_RDONLY, 0);
+	if (fd < 0) {
+	    continue;
+	}
+	struct stat status;
+	if (fstat(fd, &status) != 0 || status.st_ino == staleInode || (size_t)status.st_size < sizeof(liveRing_t)) {
+	    close(fd);
+	    continue;
+	}
+	void* ring = mmap(NULL, sizeof(liveRing_t), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+	    perror("Unable to map live ring");
+	    exit(-1);
+	}
+	const liveRing_t* liveRing = (const liveRing_t*)ring;
+	while (__atomic_load_n(&liveRing->magic, __ATOMIC_ACQUIRE) != LIVE_RING_MAGIC) {
+	    usleep(interval * 1000);
+	}
+	if (liveRing->version != LIVE_RING_VERSION) {
+	    cerr << "Live ring version " << liveRing->version << " not supported" << endl;
+	    exit(-1);
+	}
+	if (writerExited(liveRing)) {
+	    staleInode = status.st_ino;
+	    munmap(ring, sizeof(liveRing_t));
+	    continue;
+	}
+	ringInode = status.st_ino;
+	return liveRing;
+    }
+}
+
+unsigned long long accesses(const liveReadWrite_t& rw) {
+    return rw.reads + rw.writes;
+}
+
+double remotePercent(const liveWindow_t& window) {
+    unsigned long long total = 0;
+    unsigned long long remote = 0;
+    for (uint source = 0; source < window.numNodes; source++) {
+	for (uint dest = 0; dest < window.numNodes; dest++) {
+	    total += accesses(window.nodes[source][dest]);
+	    if (source != dest) {
+		remote += accesses(window.nodes[source][dest]);
+	    }
+	}
+    }
+    return total ? 100.0 * remote / total : 0;
+}
+
+void printView(const liveRing_t* ring) {
+    const liveWindow_t& latest = history.back();
+    // clear the terminal and redraw from the top
+    cout << "\033[H\033[2J";
+    cout << "window " << latest.window << " (" << ring->windowLength << " us)"
+	 << "\tdistinct pages ~" << latest.distinctPages
+	 << "\tremote " << fixed << setprecision(1) << remotePercent(latest) << "%" << endl << endl;
+
+    cout << "accesses\tsource\\dest" << endl;
+    cout << "node";
+    for (uint dest = 0; dest < latest.numNodes; dest++) {
+	cout << '\t' << dest;
+    }
+    cout << '\t' << "remote%" << endl;
+    for (uint source = 0; source < latest.numNodes; source++) {
+	unsigned long long total = 0;
+	cout << source;
+	for (uint dest = 0; dest < latest.numNodes; dest++) {
+	    cout << '\t' << accesses(latest.nodes[source][dest]);
+	    total += accesses(latest.nodes[source][dest]);
+	}
+	unsigned long long remote = total - accesses(latest.nodes[source][source]);
+	cout << '\t' << (total ? 100.0 * remote / total : 0) << endl;
+    }
+    cout << endl;
+
+    cout << "thread\treads\twrites" << endl;
+    for (uint thread = 0; thread < latest.numThreads; thread++) {
+	auto& rw = latest.threads[thread];
+	if (accesses(rw) > 0) {
+	    cout << thread << '\t' << rw.reads << '\t' << rw.writes << endl;
+	}
+    }
+    cout << endl;
+
+    cout << "window\taccesses\tremote%\tdistinct pages" << endl;
+    for (auto& window : history) {
+	unsigned long long total = 0;
+	for (uint source = 0; source < window.numNodes; source++) {
+	    for (uint dest = 0; dest < window.numNodes; dest++) {
+		total += accesses(window.nodes[source][dest]);
+	    }
+	}
+	cout << window.window << '\t' << total << '\t' << remotePercent(window) << '\t' << window.distinctPages << endl;
+    }
+    if (ring->finished) {
+	cout << endl << "program finished" << endl;
+    }
+    cout.flush();
+}
+
+/**
+ * Polls the ring and redraws the view whenever new windows have been
+ * published. Windows overwritten before they could be read are
+ * skipped. If the traced program dies, the monitor waits for the
+ * next run to publish under the same name.
+ */
+void monitor(const string& name) {
+    const liveRing_t* ring = openRing(name);
+    uint64_t next = 0;
+    for (;;) {
+	bool finished = __atomic_load_n(&ring->finished, __ATOMIC_ACQUIRE);
+	uint64_t published = __atomic_load_n(&ring->published, __ATOMIC_ACQUIRE);
+	if (published > next + LIVE_RING_SLOTS) {
+	    next = published - LIVE_RING_SLOTS;
+	}
+	bool updated = false;
+	liveWindow_t window;
+	for (; next < published; next++) {
+	    if (liveRingRead(ring, next, &window)) {
+		history.push_back(window);
+		updated = true;
+	    }
+	}
+	while (history.size() > historyLength) {
+	    history.pop_front();
+	}
+	// redraw once more when finished to show it
+	if ((updated || finished) && !history.empty()) {
+	    printView(ring);
+	}
+	if (finished) {
+	    return;
+	}
+	if (!updated && (writerExited(ring) || currentInode(name) != ringInode)) {
+	    munmap((void*)ring, sizeof(liveRing_t));
+	    history.clear();
+	    ring = openRing(name);
+	    next = 0;
+	    continue;
+	}
+	usleep(interval * 1000);
+    }
+}
+
+void usage() {
+    cerr << "usage: numamonitor [-i interval] [-n windows] name" << endl;
+    cerr << "  name         shared memory ring given to numatrace -live" << endl;
+    cerr << "  -i interval  polling interval in milliseconds, default " << DEFAULT_INTERVAL_mS << endl;
+    cerr << "  -n windows   number of windows in the history, default " << DEFAULT_HISTORY << endl;
+    exit(-1);
+}
+
+int main(int argc, char* argv[]) {
+    const char* name(NULL);
+    for (int arg = 1; arg < argc; arg++) {
+	if (strcmp(argv[arg], "-i") == 0 && arg + 1 < argc) {
+	    interval = atoi(argv[++arg]);
+	    if (interval < 1) {
+		usage();
+	    }
+	} else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+	    int windows = atoi(argv[++arg]);
+	    if (windows < 1) {
+		usage();
+	    }
+	    historyLength = windows;
+	} else if (name == NULL && argv[arg][0] != '-') {
+	    name = argv[arg];
+	} else {
+	    usage();
+	}
+    }
+    if (name == NULL) {
+	usage();
+    }
+    monitor(name);
+}
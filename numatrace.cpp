@@ -50,11 +50,40 @@ END_LEGAL */
  *
  * PAGE_ID	NUMA_ID	#READS	#WRITES
  * 
+ * Page entries are grouped by memory segment; each group is
+ * preceded by a segment line, SEGMENT_ID being 0 stack, 1 heap,
+ * 2 static data or 3 mmap/shared mappings:
+ *
+ * SEGMENT_ID	-1	-1	-4
+ *
+ * With -stack count, stack accesses are not buffered but counted
+ * and the counts since the previous count record follow a time stamp:
+ *
+ * SEGMENT_ID	#READS	#WRITES	-5
+ *
  * The very first line will contain the thread id ranging
  * from 0-N witht the following format:
  * 
  * TID	-1	-1	-1
  * 
+ * It is followed by the machine topology, one line per cpu
+ * giving the NUMA node of the cpu, and one line per pair of
+ * nodes giving their numa_distance:
+ *
+ * CPU_ID	NUMA_ID	-1	-2
+ * NUMA_ID	NUMA_ID	DISTANCE	-3
+ * 
+ * With -live NAME the tool additionally publishes per time
+ * window aggregates to the shared memory ring /dev/shm/NAME
+ * (see liveRing.h) which can be watched with numamonitor while
+ * the program runs. -trace 0 turns the trace files off.
+ *
+ * Instrumentation can be restricted to images (-image), routines
+ * (-rtn) and code address ranges (-range), and with -roi to the
+ * region between calls to numatrace_roi_begin and numatrace_roi_end
+ * (see numatrace_roi.h). Code outside the restrictions is not
+ * instrumented at all.
+ *
  * The tool can be compiled to make use of a compressed
  * file stream by defining the COMPRESS_STREAM flag
  *
@@ -79,11 +108,18 @@ END_LEGAL */
 #include <set>
 #include <unistd.h>
 #include <numaif.h>
+#include <numa.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 
 
 #include <iostream>
 #include <fstream>
 
+#include "hyperloglog.h"
+#include "liveRing.h"
+#include "traceFormat.h"
+
 #ifdef COMPRESS_STREAM
 // sudo aptget install libboost-iostreams-dev
 // -lboost_iostreams
@@ -107,6 +143,14 @@ PIN_LOCK lock;
 
 KNOB<UINT32> KnobNumEventsInBuffer(KNOB_MODE_WRITEONCE, "pintool", "events", "10000", "approximate number of events to buffer");
 KNOB<string> KnobOutputFilePrefix(KNOB_MODE_WRITEONCE, "pintool", "o", "thread", "specify output file name prefix");
+KNOB<BOOL> KnobWriteTrace(KNOB_MODE_WRITEONCE, "pintool", "trace", "1", "write per thread trace files");
+KNOB<string> KnobLiveRing(KNOB_MODE_WRITEONCE, "pintool", "live", "", "publish per window aggregates to this shared memory ring");
+KNOB<UINT32> KnobLiveWindow(KNOB_MODE_WRITEONCE, "pintool", "window", "1000000", "live time window length in microseconds");
+KNOB<string> KnobImage(KNOB_MODE_APPEND, "pintool", "image", "", "only instrument images whose name contains this, may be repeated");
+KNOB<string> KnobRoutine(KNOB_MODE_APPEND, "pintool", "rtn", "", "only instrument routines with this name, may be repeated");
+KNOB<string> KnobRange(KNOB_MODE_APPEND, "pintool", "range", "", "only instrument code in the address range start:end, may be repeated");
+KNOB<string> KnobStack(KNOB_MODE_WRITEONCE, "pintool", "stack", "keep", "stack accesses: keep, drop or count");
+KNOB<BOOL> KnobRoi(KNOB_MODE_WRITEONCE, "pintool", "roi", "0", "only instrument between numatrace_roi_begin and numatrace_roi_end");
 
 #define PADSIZE 64
 class thread_data_t {
@@ -117,9 +161,12 @@ public:
 #else
 	ofstream ThreadStream;
 #endif
+	UINT64 stackReads;
+	UINT64 stackWrites;
 	UINT8 _pad[PADSIZE];
 };
-std::vector<thread_data_t*> localStore;
+// Pin TLS slot holding the thread_data_t of each thread
+TLS_KEY threadDataKey;
 
 int pagesize;
 
@@ -127,13 +174,34 @@ int pagesize;
  */
 struct MEMREF {
 	BOOL read;
+	UINT32 hint;
 	ADDRINT ea;
 };
 
 struct MEMCNT {
 	int read;
 	int write;
+	UINT32 hints;
+};
+
+/* Segment hints known at instrumentation time from the base register
+ * of the operand. They only refine pages the mapping table leaves as
+ * mmap, see ClassifyPage.
+ */
+#define HINT_NONE 0
+#define HINT_STACK 1
+#define HINT_STATIC 2
+
+enum STACK_MODE {
+	STACK_KEEP,
+	STACK_DROP,
+	STACK_COUNT
 };
+STACK_MODE stackMode = STACK_KEEP;
+// tool register holding the thread_data_t of the thread with -stack count
+REG stackCountReg;
+// readers parse the counts as 32 bit ints, so they are written before they reach this
+#define MAX_STACK_COUNT (1U << 30)
 
 // The buffer ID returned by the one call to PIN_DefineTraceBuffer
 BUFFER_ID bufId;
@@ -143,6 +211,32 @@ BUFFER_ID bufId;
 TLS_KEY appThreadRepresentitiveKey;
 struct timeval start;
 
+/* Machine topology written to the head of every trace file
+ */
+struct CPUNODE {
+	int cpu;
+	int node;
+};
+struct NODEDISTANCE {
+	int from;
+	int to;
+	int distance;
+};
+std::vector<CPUNODE> cpuNodes;
+std::vector<NODEDISTANCE> nodeDistances;
+std::vector<int> cpuToNode;
+
+/* Live monitoring. Every thread adds its buffers to the aggregate
+ * of the current window under the lock; the window is published to
+ * the shared memory ring once a buffer of a later window arrives.
+ */
+#define LIVE_SKETCH_PRECISION 12
+liveRing_t* liveRing = NULL;
+string liveRingName;
+liveWindow_t liveWindow;
+UINT32 liveNumNodes = 1;
+hyperLogLog_t liveDistinctPages(LIVE_SKETCH_PRECISION);
+
 UINT32 totalBuffersFilled = 0;
 UINT64 totalElementsProcessed = 0;
 
@@ -187,29 +281,410 @@ VOID APP_THREAD_REPRESENTITVE::ProcessBuffer(VOID *buf, UINT64 numElements) {
 }
 
 
+/*
+ * Publishes the window being aggregated to the live ring and starts
+ * an empty one. The caller must hold the lock.
+ */
+VOID PublishLiveWindow() {
+	if (liveWindow.window < 0) {
+		return;
+	}
+	liveWindow.distinctPages = (UINT64)liveDistinctPages.estimate();
+	liveRingPublish(liveRing, &liveWindow);
+	memset(&liveWindow, 0, sizeof(liveWindow));
+	liveWindow.window = -1;
+	liveDistinctPages.clear();
+}
+
+/*
+ * Adds the pages of one buffer to the live window aggregate.
+ * Buffers of an earlier window, from threads that filled their
+ * buffer slowly, are counted in the current window.
+ */
+VOID AddToLiveWindow(THREADID tid, int cpuid, INT64 window, const liveReadWrite_t* nodes,
+                     const std::map<void*, MEMCNT>& pages) {
+	int sourceNode = (cpuid >= 0 && cpuid < (int)cpuToNode.size()) ? cpuToNode[cpuid] : -1;
+	GetLock(&lock, tid+1);
+	if (window > liveWindow.window) {
+		PublishLiveWindow();
+		liveWindow.window = window;
+		liveWindow.numNodes = liveNumNodes;
+	}
+	for (int node = 0; node < LIVE_MAX_NODES; node++) {
+		if (sourceNode >= 0 && sourceNode < LIVE_MAX_NODES) {
+			liveWindow.nodes[sourceNode][node].reads += nodes[node].reads;
+			liveWindow.nodes[sourceNode][node].writes += nodes[node].writes;
+		}
+		if (tid < LIVE_MAX_THREADS) {
+			liveWindow.threads[tid].reads += nodes[node].reads;
+			liveWindow.threads[tid].writes += nodes[node].writes;
+		}
+	}
+	if (tid < LIVE_MAX_THREADS && tid >= liveWindow.numThreads) {
+		liveWindow.numThreads = tid + 1;
+	}
+	for (std::map<void*, MEMCNT>::const_iterator it = pages.begin(); it != pages.end(); it++) {
+		liveDistinctPages.add((unsigned long long)(it->first) / pagesize);
+	}
+	ReleaseLock(&lock);
+}
+
+/*
+ * Creates the shared memory ring for live monitoring.
+ * @return  FALSE if the ring could not be created.
+ */
+BOOL CreateLiveRing(const string& name) {
+	liveRingName = (name[0] == '/') ? name : "/" + name;
+	// never reuse the ring of an earlier run, monitors waiting for
+	// this run would see its finished flag
+	shm_unlink(liveRingName.c_str());
+	int fd = shm_open(liveRingName.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) {
+		return FALSE;
+	}
+	if (ftruncate(fd, sizeof(liveRing_t)) != 0) {
+		close(fd);
+		return FALSE;
+	}
+	void* ring = mmap(NULL, sizeof(liveRing_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if (ring == MAP_FAILED) {
+		return FALSE;
+	}
+	liveRing = (liveRing_t*)ring;
+	memset(liveRing, 0, sizeof(liveRing_t));
+	liveRing->version = LIVE_RING_VERSION;
+	liveRing->windowLength = KnobLiveWindow;
+	liveRing->pid = PIN_GetPid();
+	// readers check the magic last
+	__atomic_store_n(&liveRing->magic, LIVE_RING_MAGIC, __ATOMIC_RELEASE);
+	memset(&liveWindow, 0, sizeof(liveWindow));
+	liveWindow.window = -1;
+	if (numa_available() >= 0) {
+		liveNumNodes = min(numa_max_node() + 1, LIVE_MAX_NODES);
+	}
+	return TRUE;
+}
+
+/* Mapping table used to classify pages. Image ranges, including
+ * their bss, are static data; the rest comes from /proc/self/maps and
+ * is reread when a page is not covered by any known mapping.
+ */
+struct MAPPING {
+	ADDRINT end;
+	UINT32 segment;
+};
+PIN_LOCK mappingLock;
+std::map<ADDRINT, ADDRINT> imageRanges;
+std::map<ADDRINT, MAPPING> mappings;
+
+VOID ReadMappings() {
+	mappings.clear();
+	FILE* maps = fopen("/proc/self/maps", "r");
+	if (maps == NULL) {
+		return;
+	}
+	char line[512];
+	while (fgets(line, sizeof(line), maps) != NULL) {
+		unsigned long long start, end;
+		char perms[8];
+		char path[256];
+		path[0] = '\0';
+		if (sscanf(line, "%llx-%llx %7s %*s %*s %*s %255s", &start, &end, perms, path) < 3) {
+			continue;
+		}
+		MAPPING mapping;
+		mapping.end = (ADDRINT)end;
+		if (strcmp(path, "[heap]") == 0) {
+			mapping.segment = SEGMENT_HEAP;
+		} else if (strncmp(path, "[stack", 6) == 0) {
+			mapping.segment = SEGMENT_STACK;
+		} else {
+			mapping.segment = SEGMENT_MMAP;
+		}
+		mappings[(ADDRINT)start] = mapping;
+	}
+	fclose(maps);
+}
+
+/*
+ * @return  the mapping containing address, or mappings.end()
+ */
+std::map<ADDRINT, MAPPING>::iterator FindMapping(ADDRINT address) {
+	std::map<ADDRINT, MAPPING>::iterator it = mappings.upper_bound(address);
+	if (it == mappings.begin()) {
+		return mappings.end();
+	}
+	it--;
+	return (address < it->second.end) ? it : mappings.end();
+}
+
+/*
+ * Classifies one page by the mapping table. The hints of its accesses
+ * only decide between stack, static data and mmap for pages of other
+ * mappings, which hold the stacks of all threads but the first and
+ * code generated at run time. The caller must hold mappingLock.
+ */
+UINT32 ClassifyPage(ADDRINT page, UINT32 hints, BOOL* mappingsRead) {
+	std::map<ADDRINT, ADDRINT>::iterator image = imageRanges.upper_bound(page);
+	if (image != imageRanges.begin()) {
+		image--;
+		if (page <= image->second) {
+			return SEGMENT_STATIC;
+		}
+	}
+	std::map<ADDRINT, MAPPING>::iterator mapping = FindMapping(page);
+	if (mapping == mappings.end() && !*mappingsRead) {
+		// new mapping since the table was read, reread it at most once per buffer
+		ReadMappings();
+		*mappingsRead = TRUE;
+		mapping = FindMapping(page);
+	}
+	if (mapping != mappings.end() && mapping->second.segment != SEGMENT_MMAP) {
+		return mapping->second.segment;
+	}
+	if (hints & HINT_STACK) {
+		return SEGMENT_STACK;
+	}
+	if (hints & HINT_STATIC) {
+		return SEGMENT_STATIC;
+	}
+	return SEGMENT_MMAP;
+}
+
+/*
+ * Writes the stack accesses counted since the last record and
+ * resets the counters.
+ */
+VOID WriteStackCounts(thread_data_t* tdata) {
+	if (KnobWriteTrace && (tdata->stackReads > 0 || tdata->stackWrites > 0)) {
+		tdata->ThreadStream << SEGMENT_STACK << '\t' << tdata->stackReads << '\t' << tdata->stackWrites << '\t' << SEGMENT_COUNT_RECORD << "\n";
+	}
+	tdata->stackReads = 0;
+	tdata->stackWrites = 0;
+}
+
+/*
+ * Writes the core and time stamp line of a thread.
+ * @return  the core the thread runs on
+ */
+int WriteTimeStamp(thread_data_t* tdata, struct timeval* stamp) {
+	int cpuid = sched_getcpu();
+	gettimeofday(stamp, NULL);
+	if (KnobWriteTrace) {
+		tdata->ThreadStream << cpuid << '\t' << stamp->tv_sec - start.tv_sec << '\t' << stamp->tv_usec << '\t' << -1 << endl;
+	}
+	return cpuid;
+}
+
+/*
+ * Runs on every stack access with -stack count. The thread data is
+ * passed in a tool register, so no shared structure is touched.
+ */
+VOID CountStackAccess(thread_data_t* tdata, BOOL read) {
+	UINT64& count = read ? tdata->stackReads : tdata->stackWrites;
+	if (++count >= MAX_STACK_COUNT) {
+		// the thread may not have filled a buffer yet, a count
+		// record has to follow a time stamp of its own file
+		struct timeval stamp;
+		WriteTimeStamp(tdata, &stamp);
+		WriteStackCounts(tdata);
+	}
+}
+
+/* Instrumentation filters
+ */
+struct CODERANGE {
+	ADDRINT start;
+	ADDRINT end;
+};
+std::vector<string> imageFilters;
+std::set<string> routineFilters;
+std::vector<CODERANGE> codeRanges;
+// region of interest, nested begin/end calls are counted
+volatile BOOL roiActive = TRUE;
+INT32 roiDepth = 0;
+
+/*
+ * Reads the image, routine and address range filters from the knobs.
+ * @return  FALSE if a range is malformed.
+ */
+BOOL ReadFilters() {
+	for (UINT32 i = 0; i < KnobImage.NumberOfValues(); i++) {
+		if (!KnobImage.Value(i).empty()) {
+			imageFilters.push_back(KnobImage.Value(i));
+		}
+	}
+	for (UINT32 i = 0; i < KnobRoutine.NumberOfValues(); i++) {
+		if (!KnobRoutine.Value(i).empty()) {
+			routineFilters.insert(KnobRoutine.Value(i));
+		}
+	}
+	for (UINT32 i = 0; i < KnobRange.NumberOfValues(); i++) {
+		const string& range = KnobRange.Value(i);
+		if (range.empty()) {
+			continue;
+		}
+		size_t colon = range.find(':');
+		if (colon == string::npos) {
+			return FALSE;
+		}
+		CODERANGE codeRange;
+		codeRange.start = (ADDRINT)strtoull(range.substr(0, colon).c_str(), NULL, 0);
+		codeRange.end = (ADDRINT)strtoull(range.substr(colon + 1).c_str(), NULL, 0);
+		if (codeRange.end <= codeRange.start) {
+			return FALSE;
+		}
+		codeRanges.push_back(codeRange);
+	}
+	return TRUE;
+}
+
+/*
+ * Decides at instrumentation time whether a trace is instrumented.
+ */
+BOOL InstrumentTrace(TRACE trace) {
+	if (!roiActive) {
+		return FALSE;
+	}
+	if (imageFilters.empty() && routineFilters.empty()) {
+		return TRUE;
+	}
+	if (!routineFilters.empty()) {
+		RTN rtn = TRACE_Rtn(trace);
+		if (!RTN_Valid(rtn) || routineFilters.find(RTN_Name(rtn)) == routineFilters.end()) {
+			return FALSE;
+		}
+	}
+	if (!imageFilters.empty()) {
+		// instrumentation callbacks hold the client lock
+		IMG img = IMG_FindByAddress(TRACE_Address(trace));
+		if (!IMG_Valid(img)) {
+			return FALSE;
+		}
+		const string& imageName = IMG_Name(img);
+		for (std::vector<string>::iterator it = imageFilters.begin(); it != imageFilters.end(); it++) {
+			if (imageName.find(*it) != string::npos) {
+				return TRUE;
+			}
+		}
+		return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL InCodeRange(ADDRINT address) {
+	if (codeRanges.empty()) {
+		return TRUE;
+	}
+	for (std::vector<CODERANGE>::iterator it = codeRanges.begin(); it != codeRanges.end(); it++) {
+		if (address >= it->start && address < it->end) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*
+ * Region of interest markers. Entering or leaving the region flushes
+ * the code cache so that all code is instrumented again with the new
+ * state; outside the region no analysis code is executed.
+ */
+VOID RoiBegin(THREADID tid) {
+	GetLock(&lock, tid+1);
+	if (roiDepth++ == 0) {
+		roiActive = TRUE;
+		PIN_RemoveInstrumentation();
+	}
+	ReleaseLock(&lock);
+}
+
+VOID RoiEnd(THREADID tid) {
+	GetLock(&lock, tid+1);
+	if (roiDepth > 0 && --roiDepth == 0) {
+		roiActive = FALSE;
+		PIN_RemoveInstrumentation();
+	}
+	ReleaseLock(&lock);
+}
+
+VOID ImageUnload(IMG img, VOID *v) {
+	GetLock(&mappingLock, 1);
+	imageRanges.erase(IMG_LowAddress(img));
+	ReleaseLock(&mappingLock);
+}
+
+VOID ImageLoad(IMG img, VOID *v) {
+	GetLock(&mappingLock, 1);
+	imageRanges[IMG_LowAddress(img)] = IMG_HighAddress(img);
+	ReleaseLock(&mappingLock);
+	if (!KnobRoi) {
+		return;
+	}
+	RTN rtn = RTN_FindByName(img, "numatrace_roi_begin");
+	if (RTN_Valid(rtn)) {
+		RTN_Open(rtn);
+		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiBegin, IARG_THREAD_ID, IARG_END);
+		RTN_Close(rtn);
+	}
+	rtn = RTN_FindByName(img, "numatrace_roi_end");
+	if (RTN_Valid(rtn)) {
+		RTN_Open(rtn);
+		RTN_InsertCall(rtn, IPOINT_BEFORE, (AFUNPTR)RoiEnd, IARG_THREAD_ID, IARG_END);
+		RTN_Close(rtn);
+	}
+}
+
+/*
+ * Buffers one memory operand with its segment hint; stack operands
+ * are dropped or only counted depending on -stack.
+ */
+VOID InstrumentMemoryOperand(INS ins, UINT32 memOp, BOOL read, BOOL stack, BOOL ipRel) {
+	if (stack && stackMode == STACK_DROP) {
+		return;
+	}
+	if (stack && stackMode == STACK_COUNT) {
+		INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)CountStackAccess,
+		               IARG_REG_VALUE, stackCountReg, IARG_BOOL, read, IARG_END);
+		return;
+	}
+	UINT32 hint = stack ? HINT_STACK : (ipRel ? HINT_STATIC : HINT_NONE);
+	INS_InsertFillBuffer(ins, IPOINT_BEFORE, bufId,
+	                     IARG_BOOL, read, offsetof(struct MEMREF, read),
+	                     IARG_UINT32, hint, offsetof(struct MEMREF, hint),
+	                     IARG_MEMORYOP_EA, memOp, offsetof(struct MEMREF, ea),
+	                     IARG_END);
+}
+
 /*
  * Insert code to write data to a thread-specific buffer for instructions
  * that access memory.
  */
 VOID Trace(TRACE trace, VOID *v) {
+	if (!InstrumentTrace(trace)) {
+		return;
+	}
 	// Insert a call to record the effective address.
 	for(BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl=BBL_Next(bbl)) {
 		for(INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins=INS_Next(ins)) {
+			if (!InCodeRange(INS_Address(ins))) {
+				continue;
+			}
 			UINT32 memOperands = INS_MemoryOperandCount(ins);
 
 			// Iterate over each memory operand of the instruction.
 			for (UINT32 memOp = 0; memOp < memOperands; memOp++) {
+				// only stack pointer based operands, including the implicit ones of
+				// push, pop, call and ret, are stack accesses; optimized code uses
+				// the frame pointer as a general register
+				REG base = INS_OperandMemoryBaseReg(ins, INS_MemoryOperandIndexToOperandIndex(ins, memOp));
+				BOOL stack = (base == REG_STACK_PTR);
+				BOOL ipRel = (base == REG_INST_PTR);
 				if (INS_MemoryOperandIsRead(ins, memOp)) {
-					INS_InsertFillBuffer(ins, IPOINT_BEFORE, bufId,
-					                     IARG_BOOL, TRUE, offsetof(struct MEMREF, read),
-					                     IARG_MEMORYOP_EA, memOp, offsetof(struct MEMREF, ea),
-					                     IARG_END);
+					InstrumentMemoryOperand(ins, memOp, TRUE, stack, ipRel);
 				}
 				if (INS_MemoryOperandIsWritten(ins, memOp)) {
-					INS_InsertFillBuffer(ins, IPOINT_BEFORE, bufId,
-					                     IARG_BOOL, FALSE, offsetof(struct MEMREF, read),
-					                     IARG_MEMORYOP_EA, memOp, offsetof(struct MEMREF, ea),
-					                     IARG_END);
+					InstrumentMemoryOperand(ins, memOp, FALSE, stack, ipRel);
 				}
 			}
 		}
@@ -236,17 +711,16 @@ VOID Trace(TRACE trace, VOID *v) {
  */
 VOID * BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf,
                   UINT64 numElements, VOID *v) {
-	thread_data_t* tdata = localStore[tid];
+	thread_data_t* tdata = static_cast<thread_data_t*>(PIN_GetThreadData(threadDataKey, tid));
 #ifdef COMPRESS_STREAM
 	boost::iostreams::filtering_ostream& ThreadStream = tdata->ThreadStream;
 #else
 	ofstream& ThreadStream = tdata->ThreadStream;
 #endif
-	int cpuid = sched_getcpu();
-	struct timeval stamp;
-	gettimeofday(&stamp, NULL);
 	// print core and time stamp
-	ThreadStream << cpuid << '\t' << stamp.tv_sec - start.tv_sec << '\t' << stamp.tv_usec << '\t' << -1 << endl;
+	struct timeval stamp;
+	int cpuid = WriteTimeStamp(tdata, &stamp);
+	WriteStackCounts(tdata);
 
 	if (numElements < 1) {
 		return buf;
@@ -261,6 +735,7 @@ VOID * BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf,
 		void* page = (void*)((unsigned long long)(memref->ea) & ~(pagesize-1));
 		// standard new page counts are guarenteed to be 0 as per the STL standard
 		MEMCNT& pageCnt = pages[page];
+		pageCnt.hints |= memref->hint;
 		if (memref->read) {
 			pageCnt.read += 1;
 		} else {
@@ -268,15 +743,45 @@ VOID * BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf,
 		}
 
 	}
-	// for each page, look up which numa domain it belongs to
-	// print the page id, numa domain, # reads, # writes
+	// group the pages by segment
+	std::vector<std::map<void*, MEMCNT>::iterator> segmentPages[NUM_SEGMENTS];
+	BOOL mappingsRead = FALSE;
+	GetLock(&mappingLock, tid+1);
 	for (std::map<void*, MEMCNT>::iterator it = pages.begin(); it != pages.end(); it++) {
-		int status[1];
-		status[0]=-1;
-		void * ptr_to_check = it->first;
-		move_pages(0 /*self memory */, 1, &ptr_to_check,  NULL, status, 0);
+		segmentPages[ClassifyPage((ADDRINT)it->first, it->second.hints, &mappingsRead)].push_back(it);
+	}
+	ReleaseLock(&mappingLock);
 
-		ThreadStream << ((unsigned long long)(it->first))/pagesize << '\t' << status[0] << '\t' << it->second.read << '\t' << it->second.write << "\n";
+	liveReadWrite_t liveNodes[LIVE_MAX_NODES];
+	memset(liveNodes, 0, sizeof(liveNodes));
+	// for each page, look up which numa domain it belongs to
+	// print the page id, numa domain, # reads, # writes
+	for (int segment = 0; segment < NUM_SEGMENTS; segment++) {
+		if (segmentPages[segment].empty()) {
+			continue;
+		}
+		if (KnobWriteTrace) {
+			ThreadStream << segment << '\t' << -1 << '\t' << -1 << '\t' << SEGMENT_RECORD << "\n";
+		}
+		for (size_t i = 0; i < segmentPages[segment].size(); i++) {
+			std::map<void*, MEMCNT>::iterator it = segmentPages[segment][i];
+			int status[1];
+			status[0]=-1;
+			void * ptr_to_check = it->first;
+			move_pages(0 /*self memory */, 1, &ptr_to_check,  NULL, status, 0);
+
+			if (KnobWriteTrace) {
+				ThreadStream << ((unsigned long long)(it->first))/pagesize << '\t' << status[0] << '\t' << it->second.read << '\t' << it->second.write << "\n";
+			}
+			if (liveRing && status[0] >= 0 && status[0] < LIVE_MAX_NODES) {
+				liveNodes[status[0]].reads += it->second.read;
+				liveNodes[status[0]].writes += it->second.write;
+			}
+		}
+	}
+	if (liveRing) {
+		INT64 window = ((INT64)(stamp.tv_sec - start.tv_sec) * 1000000 + stamp.tv_usec) / KnobLiveWindow;
+		AddToLiveWindow(tid, cpuid, window, liveNodes, pages);
 	}
 	// return the buffer to start filling
 	return buf;
@@ -285,6 +790,36 @@ VOID * BufferFull(BUFFER_ID id, THREADID tid, const CONTEXT *ctxt, VOID *buf,
 
 
 
+/*
+ * Reads the cpu to node map and the node distances from libnuma.
+ * Leaves the topology empty if the system has no NUMA support.
+ */
+VOID ReadTopology() {
+	if (numa_available() < 0) {
+		return;
+	}
+	int cpus = numa_num_configured_cpus();
+	for (int cpu = 0; cpu < cpus; cpu++) {
+		int node = numa_node_of_cpu(cpu);
+		if (node >= 0) {
+			CPUNODE cpuNode = {cpu, node};
+			cpuNodes.push_back(cpuNode);
+		}
+		cpuToNode.push_back(node);
+	}
+	int maxNode = numa_max_node();
+	for (int from = 0; from <= maxNode; from++) {
+		for (int to = 0; to <= maxNode; to++) {
+			int distance = numa_distance(from, to);
+			// 0 means the distance could not be determined
+			if (distance > 0) {
+				NODEDISTANCE nodeDistance = {from, to, distance};
+				nodeDistances.push_back(nodeDistance);
+			}
+		}
+	}
+}
+
 VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
 	GetLock(&lock, tid+1);
 	// There is a new APP_THREAD_REPRESENTITVE for every thread.
@@ -293,9 +828,17 @@ VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
 	// A thread will need to look up its APP_THREAD_REPRESENTITVE, so save pointer in TLS
 	PIN_SetThreadData(appThreadRepresentitiveKey, appThreadRepresentitive, tid);
 
-	localStore.resize(tid+1);
-	localStore[tid] = new thread_data_t();
-	thread_data_t* tdata = localStore[tid];
+	thread_data_t* tdata = new thread_data_t();
+	tdata->stackReads = 0;
+	tdata->stackWrites = 0;
+	PIN_SetThreadData(threadDataKey, tdata, tid);
+	if (stackMode == STACK_COUNT) {
+		PIN_SetContextReg(ctxt, stackCountReg, (ADDRINT)tdata);
+	}
+	if (!KnobWriteTrace) {
+		ReleaseLock(&lock);
+		return;
+	}
 	char file[80];
 #ifdef COMPRESS_STREAM
 	sprintf(file, "%s_%i.dat.gz", KnobOutputFilePrefix.Value().c_str(), tid);
@@ -307,6 +850,12 @@ VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v) {
 	tdata->ThreadStream.open(file);
 #endif
 	tdata->ThreadStream << tid << '\t' << -1 << '\t' << -1 << '\t' << -1 << endl;
+	for (std::vector<CPUNODE>::iterator it = cpuNodes.begin(); it != cpuNodes.end(); it++) {
+		tdata->ThreadStream << it->cpu << '\t' << it->node << '\t' << -1 << '\t' << CPU_NODE_RECORD << "\n";
+	}
+	for (std::vector<NODEDISTANCE>::iterator it = nodeDistances.begin(); it != nodeDistances.end(); it++) {
+		tdata->ThreadStream << it->from << '\t' << it->to << '\t' << it->distance << '\t' << NODE_DISTANCE_RECORD << "\n";
+	}
 	ReleaseLock(&lock);
 }
 
@@ -320,7 +869,10 @@ VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v) {
 
 	PIN_SetThreadData(appThreadRepresentitiveKey, 0, tid);
 
-	thread_data_t* tdata = localStore[tid];
+	if (!KnobWriteTrace) {
+		return;
+	}
+	thread_data_t* tdata = static_cast<thread_data_t*>(PIN_GetThreadData(threadDataKey, tid));
 #ifdef COMPRESS_STREAM
 	boost::iostreams::filtering_ostream& ThreadStream = tdata->ThreadStream;
 	boost::iostreams::close(ThreadStream);
@@ -330,6 +882,12 @@ VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v) {
 }
 
 VOID Fini(INT32 code, VOID *v) {
+	if (liveRing) {
+		PublishLiveWindow();
+		__atomic_store_n(&liveRing->finished, 1, __ATOMIC_RELEASE);
+		// monitors that have the ring mapped keep reading it
+		shm_unlink(liveRingName.c_str());
+	}
 }
 
 INT32 Usage() {
@@ -337,6 +895,15 @@ INT32 Usage() {
 	printf( "Output of each thread is stored in a separate file. \n");
 	printf ("The following command line options are available:\n");
 	printf ("-events <num>   :number of memory events to buffer,         default 10000\n");
+	printf ("-o <prefix>     :prefix of the trace files,                 default thread\n");
+	printf ("-trace <0|1>    :write per thread trace files,              default 1\n");
+	printf ("-live <name>    :publish live aggregates to shm ring <name>, default off\n");
+	printf ("-window <usec>  :live time window length,                   default 1000000\n");
+	printf ("-image <name>   :only instrument images containing <name>,  default all\n");
+	printf ("-rtn <name>     :only instrument routine <name>,            default all\n");
+	printf ("-range <s:e>    :only instrument code in [s, e),            default all\n");
+	printf ("-roi <0|1>      :only instrument between roi markers,       default 0\n");
+	printf ("-stack <mode>   :stack accesses: keep, drop or count,       default keep\n");
 	return -1;
 }
 
@@ -355,9 +922,33 @@ int main(int argc, char *argv[]) {
 		return Usage();
 	}
 
+	if (!ReadFilters()) {
+		printf ("Error: -range expects start:end\n");
+		return Usage();
+	}
+	// symbols are needed for routine names and the roi markers
+	if (KnobRoi || !routineFilters.empty()) {
+		PIN_InitSymbols();
+	}
+	roiActive = !KnobRoi;
+	if (KnobStack.Value() == "drop") {
+		stackMode = STACK_DROP;
+	} else if (KnobStack.Value() == "count") {
+		stackMode = STACK_COUNT;
+	} else if (KnobStack.Value() != "keep") {
+		printf ("Error: -stack expects keep, drop or count\n");
+		return Usage();
+	}
+	if (KnobLiveWindow == 0) {
+		printf ("Error: -window must be at least 1\n");
+		return Usage();
+	}
+
 	pagesize = getpagesize();
+	ReadTopology();
 	// Initialize the pin lock
 	InitLock(&lock);
+	InitLock(&mappingLock);
 	// Initialize the memory reference buffer
 
 	UINT32 bufferPages = (UINT32) ((KnobNumEventsInBuffer * sizeof(MEMREF)) / pagesize);
@@ -372,11 +963,26 @@ int main(int argc, char *argv[]) {
 		return 1;
 	}
 
+	if (!KnobLiveRing.Value().empty() && !CreateLiveRing(KnobLiveRing.Value())) {
+		printf ("Error: could not create live ring %s\n", KnobLiveRing.Value().c_str());
+		return 1;
+	}
+
 	// Initialize thread-specific data not handled by buffering api.
 	appThreadRepresentitiveKey = PIN_CreateThreadDataKey(0);
+	threadDataKey = PIN_CreateThreadDataKey(0);
+	if (stackMode == STACK_COUNT) {
+		stackCountReg = PIN_ClaimToolRegister();
+		if (!REG_valid(stackCountReg)) {
+			printf ("Error: no tool register left for -stack count\n");
+			return 1;
+		}
+	}
 
 	// add an instrumentation function
 	TRACE_AddInstrumentFunction(Trace, 0);
+	IMG_AddInstrumentFunction(ImageLoad, 0);
+	IMG_AddUnloadFunction(ImageUnload, 0);
 
 	// add callbacks
 	PIN_AddThreadStartFunction(ThreadStart, 0);
@@ -0,0 +1,30 @@
+/*
+ * numatrace_roi.h
+ * Region of interest markers for numatrace -roi 1. Include in the
+ * application and call numatrace_roi_begin() before and
+ * numatrace_roi_end() after the phase to trace. Calls may be nested.
+ * Without numatrace the markers are empty functions.
+ *
+ * The markers are found by name, so the binary must keep its
+ * symbol table (do not strip it).
+ */
+#ifndef NUMATRACE_ROI_H
+#define NUMATRACE_ROI_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+__attribute__((noinline, weak)) void numatrace_roi_begin(void) {
+    __asm__ volatile("");
+}
+
+__attribute__((noinline, weak)) void numatrace_roi_end(void) {
+    __asm__ volatile("");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -10,6 +10,8 @@
 #include <map>
 #include <vector>
 
+#include "traceFormat.h"
+
 
 #define MAX_LINE 100
 #define MAX_OTHER_WORDS 3
@@ -85,7 +87,11 @@ void processInputStream() {
 	    otherWords[w] = atoi(input_line + i);
 	}
 	//cout << word1 << '\t' << otherWords[0] << '\t' << otherWords[1] << '\t' << otherWords[2] << endl;
-	if (otherWords[2] /* 4th column */ != -1) {
+	if (otherWords[2] == CPU_NODE_RECORD || otherWords[2] == NODE_DISTANCE_RECORD
+	    || otherWords[2] == SEGMENT_RECORD || otherWords[2] == SEGMENT_COUNT_RECORD) {
+	    // topology and segment records are not needed for page counts
+	    continue;
+	} else if (otherWords[2] /* 4th column */ != -1) {
 	    processMemoryEntry((pageID_t)word1, (Node_t)otherWords[0], otherWords[1], otherWords[2]);
 	} else if (otherWords[1] /* 3rd column */ != -1) {
 	    processTimeStampEntry((Core_t)word1, otherWords[0], otherWords[1]);
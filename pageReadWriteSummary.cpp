@@ -4,6 +4,11 @@
 #include <assert.h>
 #include <map>
 #include <bitset>
+#include <vector>
+#include <string.h>
+
+#include "hyperloglog.h"
+#include "traceFormat.h"
 
 
 #define MAX_LINE 100
@@ -11,7 +16,9 @@
 
 #define MILLION 1000000
 #define DEFAULT_TIME_WINDOW_LENGTH_uS 1000000
+
 #define MAX_THREADS 32
+#define DEFAULT_SKETCH_PRECISION 12
 
 typedef unsigned long long pageID_t;
 typedef int timeWindow_t;
@@ -19,19 +26,115 @@ typedef int timeWindow_t;
 
 using namespace std;
 
+#define UNKNOWN_SEGMENT -1
+#define ALL_SEGMENTS -2
+// frames are kept per segment when broken down by segment
+typedef pair<timeWindow_t, int> frameKey_t;
+
 struct PageRecords_t {
     map<pageID_t, bitset<MAX_THREADS> > readByThreads;
     map<pageID_t, bitset<MAX_THREADS> > writeByThreads;
 };
 
+/*
+ * Approximate mode keeps per time window a HyperLogLog sketch of the
+ * pages touched (read or written) and one of the pages written, and
+ * an adaptive distinct sample of the pages (Gibbons): a page is
+ * sampled if the low `level` bits of its hash are 0, and whenever the
+ * sample exceeds its capacity the level is raised and the pages that
+ * no longer qualify are dropped. For a sampled page it is recorded
+ * whether it was written and whether more than one thread touched
+ * it, so the sample splits the sketch counts into the shared and
+ * private categories independent of the number of threads.
+ */
+struct SampledPage_t {
+    int firstThread;
+    bool shared;
+    bool written;
+};
+struct WindowSketch_t {
+    WindowSketch_t(int precision) : touched(precision), written(precision), level(0) {}
+    hyperLogLog_t touched;
+    hyperLogLog_t written;
+    int level;
+    map<pageID_t, SampledPage_t> sample;
+};
+
 int timeWindowLength(DEFAULT_TIME_WINDOW_LENGTH_uS);
 int activeThread(-1);
 timeWindow_t activeTimeWindow(-1);
-map<timeWindow_t, PageRecords_t> timeWindows;
-PageRecords_t* activePageRecords;
+int activeSegment(UNKNOWN_SEGMENT);
+map<frameKey_t, PageRecords_t> timeWindows;
+PageRecords_t* activePageRecords(NULL);
+
+bool bySegment(false);
+bool approximate(false);
+int sketchPrecision(DEFAULT_SKETCH_PRECISION);
+map<frameKey_t, WindowSketch_t> sketchWindows;
+WindowSketch_t* activeSketch(NULL);
+
+/**
+ * When broken down by segment, records are selected on the first
+ * memory entry after a time stamp or segment record, so that no
+ * empty segments are reported.
+ */
+void selectActiveRecords() {
+    frameKey_t frame(activeTimeWindow, bySegment ? activeSegment : ALL_SEGMENTS);
+    if (approximate) {
+	auto it = sketchWindows.find(frame);
+	if (it == sketchWindows.end()) {
+	    it = sketchWindows.insert(make_pair(frame, WindowSketch_t(sketchPrecision))).first;
+	}
+	activeSketch = &(it->second);
+    } else {
+	activePageRecords = &(timeWindows[frame]);
+    }
+}
+
+bool inSample(unsigned long long hash, int level) {
+    return (hash & ((1ULL << level) - 1)) == 0;
+}
+
+void sketchPage(WindowSketch_t& sketch, pageID_t page, bool written) {
+    unsigned long long hash = hyperLogLog_t::hash(page);
+    sketch.touched.addHash(hash);
+    if (written) {
+	sketch.written.addHash(hash);
+    }
+    if (!inSample(hash, sketch.level)) {
+	return;
+    }
+    auto it = sketch.sample.find(page);
+    if (it != sketch.sample.end()) {
+	it->second.shared |= (it->second.firstThread != activeThread);
+	it->second.written |= written;
+	return;
+    }
+    SampledPage_t sampled = {activeThread, false, written};
+    sketch.sample.insert(make_pair(page, sampled));
+    // the sample holds at most 2^precision pages
+    while (sketch.sample.size() > (1U << sketchPrecision)) {
+	sketch.level++;
+	for (auto sampled = sketch.sample.begin(); sampled != sketch.sample.end(); ) {
+	    if (inSample(hyperLogLog_t::hash(sampled->first), sketch.level)) {
+		++sampled;
+	    } else {
+		sketch.sample.erase(sampled++);
+	    }
+	}
+    }
+}
 
 void processMemoryEntry(pageID_t page, int numaID, int reads, int writes) {
     assert(activeTimeWindow >= 0 && "time window not set");
+    if (activePageRecords == NULL && activeSketch == NULL) {
+	selectActiveRecords();
+    }
+    if (approximate) {
+	assert((reads > 0 || writes > 0) && "memory entry should have at least 1 read or write");
+	sketchPage(*activeSketch, page, writes > 0);
+	return;
+    }
     auto& writeByThreads = (*activePageRecords).writeByThreads;
     auto& readByThreads = (*activePageRecords).readByThreads;
     
@@ -46,18 +149,113 @@ void processMemoryEntry(pageID_t page, int numaID, int reads, int writes) {
 }
 
 void processThreadEntry(int pid) {
-    assert((pid < MAX_THREADS) && "pid greater than bit count");
+    // only the exact mode keeps a bit per thread
+    assert((approximate || pid < MAX_THREADS) && "pid greater than bit count");
     activeThread = pid;
 }
 
 void processTimeStampEntry(int core, int sec, int usec) {
     assert((activeThread >= 0) && "thread id is not set");
-    unsigned long long time = MILLION*sec + usec;
+    assert((sec >= 0 && usec >= 0) && "negative time stamp");
+    unsigned long long time = (unsigned long long)MILLION * sec + usec;
     activeTimeWindow = (timeWindow_t)(time / timeWindowLength);
-    activePageRecords = &(timeWindows[activeTimeWindow]);
+    // traces without segment records are reported as unknown segment
+    activeSegment = UNKNOWN_SEGMENT;
+    activePageRecords = NULL;
+    activeSketch = NULL;
+    if (!bySegment) {
+	selectActiveRecords();
+    }
 }
 
-int main() {
+void processSegmentEntry(int segment) {
+    assert((segment >= 0 && segment < NUM_SEGMENTS) && "unknown memory segment");
+    activeSegment = segment;
+    if (bySegment) {
+	activePageRecords = NULL;
+	activeSketch = NULL;
+    }
+}
+
+void printFrameID(const frameKey_t& frame) {
+    cout << frame.first << '\t';
+    if (bySegment) {
+	cout << (frame.second == UNKNOWN_SEGMENT ? "unknown" : segmentNames[frame.second]) << '\t';
+    }
+}
+
+int estimateToCount(double estimate) {
+    return estimate > 0 ? (int)(estimate + 0.5) : 0;
+}
+
+/**
+ * Splits count in the proportion part / (part + other) of the sample.
+ */
+int splitCount(int count, int part, int other) {
+    return (part + other) > 0 ? estimateToCount((double)count * part / (part + other)) : 0;
+}
+
+/**
+ * Estimates the page categories of one time window. Pages Read and
+ * Pages Written come from the sketches, the shared and private split
+ * from the sample. As long as the sample has never been thinned out
+ * it holds every page of the window and the counts are exact.
+ */
+void printSketchWindow(const frameKey_t& frameID, const WindowSketch_t& sketch) {
+    int privateRead = 0;
+    int sharedRead = 0;
+    int privateWrite = 0;
+    int sharedWrite = 0;
+    for (auto& sampled : sketch.sample) {
+	if (sampled.second.written) {
+	    (sampled.second.shared ? sharedWrite : privateWrite)++;
+	} else {
+	    (sampled.second.shared ? sharedRead : privateRead)++;
+	}
+    }
+    int pageReads = privateRead + sharedRead + privateWrite + sharedWrite;
+    int pageWrites = privateWrite + sharedWrite;
+    if (sketch.level > 0) {
+	pageReads = estimateToCount(sketch.touched.estimate());
+	pageWrites = min(estimateToCount(sketch.written.estimate()), pageReads);
+	int readOnly = pageReads - pageWrites;
+	privateWrite = splitCount(pageWrites, privateWrite, sharedWrite);
+	sharedWrite = pageWrites - privateWrite;
+	privateRead = splitCount(readOnly, privateRead, sharedRead);
+	sharedRead = readOnly - privateRead;
+    }
+
+    printFrameID(frameID);
+    cout << pageReads << '\t' << pageWrites << '\t';
+    cout << privateRead << '\t' << sharedRead << '\t' << privateWrite << '\t' << sharedWrite  << endl;
+}
+
+void usage() {
+    cerr << "usage: pageReadWriteSummary [-s] [-a] [-p precision]" << endl;
+    cerr << "  -s            break the counts down by memory segment" << endl;
+    cerr << "  -a            approximate page counts with HyperLogLog sketches and a page sample" << endl;
+    cerr << "  -p precision  sketch precision in bits (" << HLL_MIN_PRECISION << "-" << HLL_MAX_PRECISION
+	 << "), default " << DEFAULT_SKETCH_PRECISION << ", implies -a" << endl;
+    exit(-1);
+}
+
+int main(int argc, char* argv[]) {
+    for (int arg = 1; arg < argc; arg++) {
+	if (strcmp(argv[arg], "-s") == 0) {
+	    bySegment = true;
+	} else if (strcmp(argv[arg], "-a") == 0) {
+	    approximate = true;
+	} else if (strcmp(argv[arg], "-p") == 0 && arg + 1 < argc) {
+	    approximate = true;
+	    sketchPrecision = atoi(argv[++arg]);
+	    if (sketchPrecision < HLL_MIN_PRECISION || sketchPrecision > HLL_MAX_PRECISION) {
+		usage();
+	    }
+	} else {
+	    usage();
+	}
+    }
+
     char input_line[MAX_LINE];
     char *result;
 
@@ -75,7 +273,15 @@ int main() {
 	    otherWords[w] = atoi(input_line + i);
 	}
 	//cout << word1 << '\t' << otherWords[0] << '\t' << otherWords[1] << '\t' << otherWords[2] << endl;
-	if (otherWords[2] /* 4th column */ != -1) {
+	if (otherWords[2] == CPU_NODE_RECORD || otherWords[2] == NODE_DISTANCE_RECORD) {
+	    // topology records are not needed for page counts
+	    continue;
+	} else if (otherWords[2] == SEGMENT_RECORD) {
+	    processSegmentEntry((int)word1);
+	} else if (otherWords[2] == SEGMENT_COUNT_RECORD) {
+	    // counted accesses carry no pages
+	    continue;
+	} else if (otherWords[2] /* 4th column */ != -1) {
 	    processMemoryEntry((pageID_t)word1, otherWords[0], otherWords[1], otherWords[2]);
 	} else if (otherWords[1] /* 3rd column */ != -1) {
 	    processTimeStampEntry((int)word1, otherWords[0], otherWords[1]);
@@ -90,7 +296,13 @@ int main() {
     if (ferror(stdin))
 	perror("Error reading stdin.");
 
-    cout << "Time Frame\tPages Read\tPages Written\tPrivate Read Only\tShared Read Only\tPrivate Write\tShared Write" << endl;
+    cout << "Time Frame\t" << (bySegment ? "Segment\t" : "") << "Pages Read\tPages Written\tPrivate Read Only\tShared Read Only\tPrivate Write\tShared Write" << endl;
+    if (approximate) {
+	for (auto& timeFrame : sketchWindows) {
+	    printSketchWindow(timeFrame.first, timeFrame.second);
+	}
+	return 0;
+    }
     for (auto timeFrame : timeWindows) {
 	int privateWrite = 0;
 	int privateRead = 0;
@@ -131,7 +343,8 @@ int main() {
 		}
 	    }
 	}
-	cout << frameID << '\t' << pageReads << '\t' << pageWrites << '\t';
+	printFrameID(frameID);
+	cout << pageReads << '\t' << pageWrites << '\t';
 	cout << privateRead << '\t' << sharedRead << '\t' << privateWrite << '\t' << sharedWrite  << endl;
     }
 }
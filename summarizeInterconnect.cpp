@@ -3,6 +3,7 @@
 #include <string>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include <sstream>
@@ -10,12 +11,19 @@
 #include <map>
 #include <vector>
 
+#include "traceFormat.h"
+
 
 #define MAX_LINE 100
 #define MAX_OTHER_WORDS 3
 
 #define MILLION 1000000
 #define DEFAULT_TIME_WINDOW_LENGTH_uS 1000000
+// upper bound on the time windows of a trace, about 12 days of 1 second windows
+#define MAX_TIME_WINDOWS (1 << 20)
+
+// numa_distance of a node to itself, remote nodes default to twice that
+#define LOCAL_DISTANCE 10
 
 
 using namespace std;
@@ -28,6 +36,8 @@ struct readWrite_t{
     uint reads;
     uint writes;
 };
+// rows x cols matrix of one frame, stored row major
+typedef vector<readWrite_t> frameMatrix_t;
 
 std::vector<std::string> &split(const std::string &s, char delim, std::vector<std::string> &elems) {
     std::stringstream ss(s);
@@ -47,37 +57,175 @@ std::vector<std::string> split(const std::string &s, const char delim) {
 
 
 
+/*
+ * NUMA topology, either from the configuration file or from the
+ * topology records numatrace writes to the head of every trace.
+ * The configuration file overrides the embedded cpu to node map.
+ */
+map<Core_t, Node_t> numaMap;
+bool numaMapFromConfig(false);
+int configNodes(0);     // highest node id in the configuration file + 1, including nodes without cpus
+map<pair<Node_t, Node_t>, int> embeddedDistances;
+
+/*
+ * Dense interconnect engine. Traffic is kept in contiguous arrays
+ * sized from the NUMA topology and indexed by time window,
+ * source and destination, so every memory entry is a couple of
+ * array increments. The per thread and per core breakdowns are only
+ * kept when their output is requested.
+ */
 int timeWindowLength(DEFAULT_TIME_WINDOW_LENGTH_uS);
-map<timeWindow_t, map<Node_t, map<Node_t, readWrite_t> > > timeWindows;
-map<Node_t, readWrite_t>* activeSourceNode(NULL);
+int numNodes(0);
+int numCores(0);
+vector<Node_t> coreToNode;                    // [core], -1 if not in configuration
+vector<int> nodeDistance;                     // [sourceNode][destNode]
+timeWindow_t firstWindow(-1);
+timeWindow_t numWindows(0);
+vector<readWrite_t> nodeTraffic;              // [window][sourceNode][destNode]
+vector<readWrite_t> coreTraffic;              // [window][core][destNode]
+vector<vector<readWrite_t> > threadTraffic;   // [thread][window][destNode]
+vector<readWrite_t> segmentTraffic;           // [window][segment][sourceNode][destNode]
+bool trackThreads(false);
+bool trackCores(false);
+bool trackSegments(false);
+int activeThread(0);
+timeWindow_t activeTimeWindow(-1);
+Node_t activeSource(-1);
+readWrite_t* activeSourceNode(NULL);
+readWrite_t* activeSegmentNode(NULL);
+readWrite_t* activeCore(NULL);
+readWrite_t* activeThreadNode(NULL);
+int rollingLength(1);
+int interpolateSteps(1);
 
 
 void processMemoryEntry(pageID_t page, Node_t numaID, int reads, int writes) {
     assert(activeSourceNode != NULL && "time window not set");
-    const Node_t NUMA_ERROR{-14}; 
-	if (numaID != NUMA_ERROR) {
-		(*activeSourceNode)[numaID].writes += writes;
-		(*activeSourceNode)[numaID].reads += reads;
-	}
+    // negative ids are move_pages error codes, e.g. -14 (EFAULT)
+    if (numaID < 0) {
+	return;
+    }
+    if (numaID >= numNodes) {
+	cerr << "Node " << numaID << " not found in numa map" << endl;
+	exit(-1);
+    }
+    activeSourceNode[numaID].writes += writes;
+    activeSourceNode[numaID].reads += reads;
+    if (activeCore != NULL) {
+	activeCore[numaID].writes += writes;
+	activeCore[numaID].reads += reads;
+    }
+    if (activeThreadNode != NULL) {
+	activeThreadNode[numaID].writes += writes;
+	activeThreadNode[numaID].reads += reads;
+    }
+    if (activeSegmentNode != NULL) {
+	activeSegmentNode[numaID].writes += writes;
+	activeSegmentNode[numaID].reads += reads;
+    }
+}
+
+readWrite_t* segmentRow(int segment) {
+    assert(activeTimeWindow >= 0 && "time window not set");
+    if (segment < 0 || segment >= NUM_SEGMENTS) {
+	cerr << "Unknown memory segment " << segment << endl;
+	exit(-1);
+    }
+    return &segmentTraffic[(((size_t)activeTimeWindow * NUM_SEGMENTS + segment) * numNodes + activeSource) * numNodes];
+}
+
+void processSegmentEntry(int segment) {
+    if (trackSegments) {
+	activeSegmentNode = segmentRow(segment);
+    }
+}
+
+/**
+ * Accesses that were only counted (numatrace -stack count) have no
+ * destination node; they are assumed to be local to the source node.
+ */
+void processSegmentCountEntry(int segment, int reads, int writes) {
+    if (trackSegments) {
+	readWrite_t& local = segmentRow(segment)[activeSource];
+	local.reads += reads;
+	local.writes += writes;
+    }
 }
 
 void processThreadEntry(int pid) {
-    // Do nothing, only care about nodes
+    assert((pid >= 0) && "thread id should not be negative");
+    activeThread = pid;
+}
+
+void processCpuNodeEntry(Core_t cpu, Node_t node) {
+    // every trace file repeats the topology, only the first copy is needed
+    if (numaMapFromConfig || !coreToNode.empty()) {
+	return;
+    }
+    numaMap[cpu] = node;
+}
+
+void processNodeDistanceEntry(Node_t from, Node_t to, int distance) {
+    if (!coreToNode.empty()) {
+	return;
+    }
+    embeddedDistances[make_pair(from, to)] = distance;
 }
 
-void processTimeStampEntry(Core_t core, int sec, int usec, const map<Core_t, Node_t> numaMap) {
-    unsigned long long time = MILLION*sec + usec;
-    timeWindow_t activeTimeWindow = (timeWindow_t)(time / timeWindowLength);
-    auto it = numaMap.find(core);
-    if (it == numaMap.end()) {
+void initializeEngine();
+
+void processTimeStampEntry(Core_t core, int sec, int usec) {
+    if (coreToNode.empty()) {
+	initializeEngine();
+    }
+    if (sec < 0 || usec < 0) {
+	cerr << "Invalid time stamp " << sec << " s " << usec << " us" << endl;
+	exit(-1);
+    }
+    unsigned long long time = (unsigned long long)MILLION * sec + usec;
+    if (time / timeWindowLength >= MAX_TIME_WINDOWS) {
+	cerr << "Time stamp " << sec << " s exceeds " << MAX_TIME_WINDOWS << " time windows" << endl;
+	exit(-1);
+    }
+    activeTimeWindow = (timeWindow_t)(time / timeWindowLength);
+    if (core >= (Core_t)numCores || coreToNode[core] < 0) {
 	cerr << "Core not found in numa map" << endl;
 	exit(-1);
     }
-    Node_t sourceNode = it->second;
-    activeSourceNode = &(timeWindows[activeTimeWindow][sourceNode]);
+    Node_t sourceNode = coreToNode[core];
+    activeSource = sourceNode;
+    if (activeTimeWindow >= numWindows) {
+	numWindows = activeTimeWindow + 1;
+	nodeTraffic.resize((size_t)numWindows * numNodes * numNodes);
+	if (trackCores) {
+	    coreTraffic.resize((size_t)numWindows * numCores * numNodes);
+	}
+	if (trackSegments) {
+	    segmentTraffic.resize((size_t)numWindows * NUM_SEGMENTS * numNodes * numNodes);
+	}
+    }
+    // traces without segment records are not broken down by segment
+    activeSegmentNode = NULL;
+    if (firstWindow < 0 || activeTimeWindow < firstWindow) {
+	firstWindow = activeTimeWindow;
+    }
+    activeSourceNode = &nodeTraffic[((size_t)activeTimeWindow * numNodes + sourceNode) * numNodes];
+    if (trackCores) {
+	activeCore = &coreTraffic[((size_t)activeTimeWindow * numCores + core) * numNodes];
+    }
+    if (trackThreads) {
+	if ((int)threadTraffic.size() <= activeThread) {
+	    threadTraffic.resize(activeThread + 1);
+	}
+	auto& traffic = threadTraffic[activeThread];
+	if ((int)traffic.size() < numWindows * numNodes) {
+	    traffic.resize(numWindows * numNodes);
+	}
+	activeThreadNode = &traffic[activeTimeWindow * numNodes];
+    }
 }
 
-void processInputStream(const map<Core_t, Node_t> numaMap) {
+void processInputStream() {
     char input_line[MAX_LINE];
     char *result;
     while((result = fgets(input_line, MAX_LINE, stdin )) != NULL) {
@@ -94,10 +242,18 @@ void processInputStream(const map<Core_t, Node_t> numaMap) {
 	    otherWords[w] = atoi(input_line + i);
 	}
 	//cout << word1 << '\t' << otherWords[0] << '\t' << otherWords[1] << '\t' << otherWords[2] << endl;
-	if (otherWords[2] /* 4th column */ != -1) {
+	if (otherWords[2] /* 4th column */ >= 0) {
 	    processMemoryEntry((pageID_t)word1, (Node_t)otherWords[0], otherWords[1], otherWords[2]);
+	} else if (otherWords[2] == CPU_NODE_RECORD) {
+	    processCpuNodeEntry((Core_t)word1, (Node_t)otherWords[0]);
+	} else if (otherWords[2] == NODE_DISTANCE_RECORD) {
+	    processNodeDistanceEntry((Node_t)word1, (Node_t)otherWords[0], otherWords[1]);
+	} else if (otherWords[2] == SEGMENT_RECORD) {
+	    processSegmentEntry((int)word1);
+	} else if (otherWords[2] == SEGMENT_COUNT_RECORD) {
+	    processSegmentCountEntry((int)word1, otherWords[0], otherWords[1]);
 	} else if (otherWords[1] /* 3rd column */ != -1) {
-	    processTimeStampEntry((Core_t)word1, otherWords[0], otherWords[1], numaMap);
+	    processTimeStampEntry((Core_t)word1, otherWords[0], otherWords[1]);
 	} else {
 	    assert((otherWords[0] == -1) && "2nd column should be -1");
 	    processThreadEntry((int)word1);
@@ -110,20 +266,216 @@ void processInputStream(const map<Core_t, Node_t> numaMap) {
 }
 
 
-void printOutput() {
-    cout << "frame" << '\t' << "sourceNode" << '\t' << "destNode" << '\t' << "reads" << '\t' << "writes" << endl;
-    for (auto& frame : timeWindows) {
-	for (auto& sourceNode : frame.second) {
-	    for (auto& destNode : sourceNode.second) {
-		// frame# sourceNode destNode reads writes
-		auto& rw = destNode.second; 
-		cout << frame.first << '\t' << sourceNode.first << '\t' << destNode.first << '\t' << rw.reads << '\t' << rw.writes << endl;
-	    } 
+/**
+ * Streaming output stages. Frames are pushed in order as dense
+ * matrices; the rolling stage averages the last rollingLength
+ * frames using a running sum, the interpolation stage inserts
+ * interpolateSteps - 1 linearly interpolated frames between
+ * consecutive frames. Each frame is touched a constant number of
+ * times, so the output is a single O(frames) pass.
+ */
+struct frameOutput_t {
+    frameOutput_t(ostream& out, const string& rowName, const string& colName, int rows, int cols)
+	: out(out), rowName(rowName), colName(colName), rows(rows), cols(cols),
+	  history(rollingLength), rollingReads(rows * cols), rollingWrites(rows * cols), framesSeen(0),
+	  havePrevious(false), previousFrame(0) {}
+    ostream& out;
+    string rowName;
+    string colName;
+    int rows;
+    int cols;
+    // when set the frames are printed as a distance weighted cost report
+    vector<int> distances;
+    // when set printed instead of the row numbers
+    vector<string> rowLabels;
+    // rolling average stage, history is a ring of the last rollingLength frames
+    vector<frameMatrix_t> history;
+    vector<unsigned long long> rollingReads;
+    vector<unsigned long long> rollingWrites;
+    int framesSeen;
+    // interpolation stage
+    bool havePrevious;
+    timeWindow_t previousFrame;
+    frameMatrix_t previous;
+};
+
+void printFrameHeader(frameOutput_t& output) {
+    output.out << "frame" << '\t' << output.rowName << '\t' << output.colName << '\t' << "reads" << '\t' << "writes";
+    if (!output.distances.empty()) {
+	output.out << '\t' << "distance" << '\t' << "weightedAccesses";
+    }
+    output.out << endl;
+}
+
+void printFrame(frameOutput_t& output, timeWindow_t frame, const frameMatrix_t& matrix) {
+    for (int row = 0; row < output.rows; row++) {
+	for (int col = 0; col < output.cols; col++) {
+	    auto& rw = matrix[row * output.cols + col];
+	    if (rw.reads == 0 && rw.writes == 0) {
+		continue;
+	    }
+	    output.out << frame << '\t';
+	    if (output.rowLabels.empty()) {
+		output.out << row;
+	    } else {
+		output.out << output.rowLabels[row];
+	    }
+	    output.out << '\t' << col << '\t' << rw.reads << '\t' << rw.writes;
+	    if (!output.distances.empty()) {
+		// accesses scaled by the distance relative to a local access
+		int distance = output.distances[row * output.cols + col];
+		int local = output.distances[row * output.cols + row];
+		unsigned long long accesses = (unsigned long long)rw.reads + rw.writes;
+		output.out << '\t' << distance << '\t' << accesses * distance / local;
+	    }
+	    output.out << '\n';
 	}
     }
 }
 
+void interpolateFrame(frameOutput_t& output, timeWindow_t frame, const frameMatrix_t& matrix) {
+    if (interpolateSteps <= 1) {
+	printFrame(output, frame, matrix);
+	return;
+    }
+    if (output.havePrevious) {
+	const int steps = interpolateSteps;
+	frameMatrix_t between(matrix.size());
+	printFrame(output, output.previousFrame * steps, output.previous);
+	for (int k = 1; k < steps; k++) {
+	    for (uint i = 0; i < matrix.size(); i++) {
+		auto& a = output.previous[i];
+		auto& b = matrix[i];
+		between[i].reads = ((unsigned long long)a.reads * (steps - k) + (unsigned long long)b.reads * k) / steps;
+		between[i].writes = ((unsigned long long)a.writes * (steps - k) + (unsigned long long)b.writes * k) / steps;
+	    }
+	    printFrame(output, output.previousFrame * steps + k, between);
+	}
+    }
+    output.havePrevious = true;
+    output.previousFrame = frame;
+    output.previous = matrix;
+}
+
+void pushFrame(frameOutput_t& output, timeWindow_t frame, const frameMatrix_t& matrix) {
+    if (rollingLength <= 1) {
+	interpolateFrame(output, frame, matrix);
+	return;
+    }
+    // replace the oldest frame in the ring, keeping the running sum current
+    auto& oldest = output.history[output.framesSeen % rollingLength];
+    for (uint i = 0; i < matrix.size(); i++) {
+	output.rollingReads[i] += matrix[i].reads;
+	output.rollingWrites[i] += matrix[i].writes;
+	if (output.framesSeen >= rollingLength) {
+	    output.rollingReads[i] -= oldest[i].reads;
+	    output.rollingWrites[i] -= oldest[i].writes;
+	}
+    }
+    oldest = matrix;
+    output.framesSeen++;
+    if (output.framesSeen < rollingLength) {
+	return;
+    }
+    // averaged frames are labeled with the first frame they cover
+    frameMatrix_t average(matrix.size());
+    for (uint i = 0; i < matrix.size(); i++) {
+	average[i].reads = output.rollingReads[i] / rollingLength;
+	average[i].writes = output.rollingWrites[i] / rollingLength;
+    }
+    interpolateFrame(output, frame - rollingLength + 1, average);
+}
 
+void finishFrames(frameOutput_t& output) {
+    if (output.havePrevious) {
+	printFrame(output, output.previousFrame * interpolateSteps, output.previous);
+	output.havePrevious = false;
+    }
+    output.out.flush();
+}
+
+/**
+ * Sends every frame, including empty frames in gaps, through the
+ * output stages of the node to node matrix and the optional cost,
+ * core, thread and segment breakdowns.
+ */
+void printOutput(ostream* costOut, ostream* coreOut, ostream* threadOut, ostream* segmentOut) {
+    frameOutput_t nodeOutput(cout, "sourceNode", "destNode", numNodes, numNodes);
+    printFrameHeader(nodeOutput);
+    frameOutput_t costOutput(costOut ? *costOut : cout, "sourceNode", "destNode", numNodes, numNodes);
+    if (costOut) {
+	costOutput.distances = nodeDistance;
+	printFrameHeader(costOutput);
+    }
+    frameOutput_t coreOutput(coreOut ? *coreOut : cout, "core", "destNode", numCores, numNodes);
+    if (coreOut) {
+	printFrameHeader(coreOutput);
+    }
+    int numThreads = threadTraffic.size();
+    frameOutput_t threadOutput(threadOut ? *threadOut : cout, "thread", "destNode", numThreads, numNodes);
+    if (threadOut) {
+	printFrameHeader(threadOutput);
+    }
+    frameOutput_t segmentOutput(segmentOut ? *segmentOut : cout, "segment\tsourceNode", "destNode", NUM_SEGMENTS * numNodes, numNodes);
+    if (segmentOut) {
+	for (int segment = 0; segment < NUM_SEGMENTS; segment++) {
+	    for (Node_t node = 0; node < numNodes; node++) {
+		segmentOutput.rowLabels.push_back(string(segmentNames[segment]) + '\t' + to_string(node));
+	    }
+	}
+	printFrameHeader(segmentOutput);
+    }
+    if (firstWindow < 0) {
+	return;
+    }
+    frameMatrix_t nodeMatrix(numNodes * numNodes);
+    frameMatrix_t coreMatrix(numCores * numNodes);
+    frameMatrix_t threadMatrix(numThreads * numNodes);
+    frameMatrix_t segmentMatrix(NUM_SEGMENTS * numNodes * numNodes);
+    for (timeWindow_t frame = firstWindow; frame < numWindows; frame++) {
+	auto nodeFrame = nodeTraffic.begin() + (size_t)frame * numNodes * numNodes;
+	copy(nodeFrame, nodeFrame + numNodes * numNodes, nodeMatrix.begin());
+	pushFrame(nodeOutput, frame, nodeMatrix);
+	if (costOut) {
+	    pushFrame(costOutput, frame, nodeMatrix);
+	}
+	if (coreOut) {
+	    auto coreFrame = coreTraffic.begin() + (size_t)frame * numCores * numNodes;
+	    copy(coreFrame, coreFrame + numCores * numNodes, coreMatrix.begin());
+	    pushFrame(coreOutput, frame, coreMatrix);
+	}
+	if (threadOut) {
+	    threadMatrix.assign(numThreads * numNodes, readWrite_t());
+	    for (int thread = 0; thread < numThreads; thread++) {
+		auto& traffic = threadTraffic[thread];
+		if ((int)traffic.size() < (frame + 1) * numNodes) {
+		    continue;
+		}
+		copy(traffic.begin() + frame * numNodes, traffic.begin() + (frame + 1) * numNodes,
+		     threadMatrix.begin() + thread * numNodes);
+	    }
+	    pushFrame(threadOutput, frame, threadMatrix);
+	}
+	if (segmentOut) {
+	    auto segmentFrame = segmentTraffic.begin() + (size_t)frame * NUM_SEGMENTS * numNodes * numNodes;
+	    copy(segmentFrame, segmentFrame + NUM_SEGMENTS * numNodes * numNodes, segmentMatrix.begin());
+	    pushFrame(segmentOutput, frame, segmentMatrix);
+	}
+    }
+    finishFrames(nodeOutput);
+    if (costOut) {
+	finishFrames(costOutput);
+    }
+    if (coreOut) {
+	finishFrames(coreOutput);
+    }
+    if (threadOut) {
+	finishFrames(threadOutput);
+    }
+    if (segmentOut) {
+	finishFrames(segmentOutput);
+    }
+}
 
 /**
  * Initializes NUMA layout from configuration file.
@@ -134,9 +486,12 @@ void printOutput() {
  * Format:
  * node core core core ...
  * node core core core ...
+ *
+ * Nodes without cpus (memory only) are listed with their id alone.
  */
-void loadNumaConfigurationFile(const char* filename, map<Core_t, Node_t>* _numaMap) {
+void loadNumaConfigurationFile(const char* filename, map<Core_t, Node_t>* _numaMap, int* _numNodes) {
     auto& numaMap = *_numaMap;
+    auto& numNodes = *_numNodes;
     ifstream numaFile(filename);
     string line;
     if (!numaFile.is_open()) {
@@ -150,6 +505,7 @@ void loadNumaConfigurationFile(const char* filename, map<Core_t, Node_t>* _numaM
 	}
 	auto cores = split(line, ' ');
 	Node_t n = (Node_t)atoi(cores[0].c_str());
+	numNodes = max(numNodes, n + 1);
 	for (uint i = 1; i < cores.size(); i++) {
 	    Core_t c = (Core_t)atoi(cores[i].c_str());
 	    numaMap[c] = n;   
@@ -158,14 +514,97 @@ void loadNumaConfigurationFile(const char* filename, map<Core_t, Node_t>* _numaM
     numaFile.close();
 }
 
-int main(int argc, char* argv[]) {
-    if (argc != 2) {
-	cerr << "Error no configuration file given" << endl;
+/**
+ * Sizes the dense engine from the NUMA layout and builds the O(1)
+ * core to node lookup table. Called at the first time stamp, after
+ * the topology records at the head of the trace have been read.
+ */
+void initializeEngine() {
+    if (numaMap.empty()) {
+	cerr << "No NUMA topology in trace, a configuration file is required" << endl;
 	exit(-1);
     }
-    map<Core_t, Node_t> numaMap;
-    loadNumaConfigurationFile(argv[1], &numaMap);
-    processInputStream(numaMap);
-    printOutput();
+    for (auto& coreNode : numaMap) {
+	numCores = max(numCores, (int)coreNode.first + 1);
+	numNodes = max(numNodes, coreNode.second + 1);
+    }
+    // nodes without cpus can still hold memory
+    numNodes = max(numNodes, configNodes);
+    for (auto& distance : embeddedDistances) {
+	numNodes = max(numNodes, max(distance.first.first, distance.first.second) + 1);
+    }
+    coreToNode.assign(numCores, -1);
+    for (auto& coreNode : numaMap) {
+	coreToNode[coreNode.first] = coreNode.second;
+    }
+    nodeDistance.assign(numNodes * numNodes, 2 * LOCAL_DISTANCE);
+    for (Node_t node = 0; node < numNodes; node++) {
+	nodeDistance[node * numNodes + node] = LOCAL_DISTANCE;
+    }
+    for (auto& distance : embeddedDistances) {
+	nodeDistance[distance.first.first * numNodes + distance.first.second] = distance.second;
+    }
 }
 
+void usage() {
+    cerr << "usage: summarizeInterconnect [--rolling N] [--interpolate K] [--cost file] [--cores file] [--threads file] [--segments file] [config]" << endl;
+    cerr << "  config           NUMA layout, overrides the topology embedded in the trace" << endl;
+    cerr << "  --rolling N      average every N consecutive frames" << endl;
+    cerr << "  --interpolate K  emit K frames per frame, interpolating between frames" << endl;
+    cerr << "  --cost file      write the node to node traffic weighted by node distance to file" << endl;
+    cerr << "  --cores file     write the core to node traffic to file" << endl;
+    cerr << "  --threads file   write the thread to node traffic to file" << endl;
+    cerr << "  --segments file  write the node to node traffic per memory segment to file" << endl;
+    exit(-1);
+}
+
+void openOutputFile(const char* filename, ofstream& out) {
+    out.open(filename);
+    if (!out.is_open()) {
+	cerr << "Unable to open output file " << filename << endl;
+	exit(-1);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    const char* configFile(NULL);
+    ofstream costFile;
+    ofstream coreFile;
+    ofstream threadFile;
+    ofstream segmentFile;
+    for (int arg = 1; arg < argc; arg++) {
+	if (strcmp(argv[arg], "--rolling") == 0 && arg + 1 < argc) {
+	    rollingLength = atoi(argv[++arg]);
+	    if (rollingLength < 1) {
+		usage();
+	    }
+	} else if (strcmp(argv[arg], "--interpolate") == 0 && arg + 1 < argc) {
+	    interpolateSteps = atoi(argv[++arg]);
+	    if (interpolateSteps < 1) {
+		usage();
+	    }
+	} else if (strcmp(argv[arg], "--cost") == 0 && arg + 1 < argc) {
+	    openOutputFile(argv[++arg], costFile);
+	} else if (strcmp(argv[arg], "--cores") == 0 && arg + 1 < argc) {
+	    openOutputFile(argv[++arg], coreFile);
+	    trackCores = true;
+	} else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+	    openOutputFile(argv[++arg], threadFile);
+	    trackThreads = true;
+	} else if (strcmp(argv[arg], "--segments") == 0 && arg + 1 < argc) {
+	    openOutputFile(argv[++arg], segmentFile);
+	    trackSegments = true;
+	} else if (configFile == NULL && argv[arg][0] != '-') {
+	    configFile = argv[arg];
+	} else {
+	    usage();
+	}
+    }
+    if (configFile != NULL) {
+	loadNumaConfigurationFile(configFile, &numaMap, &configNodes);
+	numaMapFromConfig = true;
+    }
+    processInputStream();
+    printOutput(costFile.is_open() ? &costFile : NULL, trackCores ? &coreFile : NULL, trackThreads ? &threadFile : NULL,
+		trackSegments ? &segmentFile : NULL);
+}
@@ -0,0 +1,483 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include <map>
+#include <vector>
+
+
+#define MAX_LINE 256
+
+#define DEFAULT_BUCKETS 100
+#define DEFAULT_REMOTE_THRESHOLD 0.05
+#define DEFAULT_TRAFFIC_THRESHOLD 0.10
+#define DEFAULT_SHARED_THRESHOLD 0.10
+
+
+using namespace std;
+
+typedef int frame_t;
+struct readWrite_t{
+    unsigned long long reads;
+    unsigned long long writes;
+};
+struct pageCounts_t {
+    double pagesRead;
+    double pagesWritten;
+    double privateRead;
+    double sharedRead;
+    double privateWrite;
+    double sharedWrite;
+};
+
+/*
+ * One side of the comparison: the node to node traffic per frame
+ * from summarizeInterconnect and optionally the page counts per
+ * frame from pageReadWriteSummary.
+ */
+struct run_t {
+    int numNodes;
+    map<frame_t, vector<readWrite_t> > traffic;   // [frame][sourceNode][destNode]
+    map<frame_t, pageCounts_t> pages;
+};
+
+/*
+ * Frames of both runs after alignment, keyed by frame number or by
+ * progress bucket. Page counts are averaged over the frames of a bin.
+ */
+struct bin_t {
+    vector<readWrite_t> traffic;
+    pageCounts_t pages;
+    int pageFrames;
+};
+
+enum align_t {
+    ALIGN_WINDOW,
+    ALIGN_PROGRESS
+};
+
+align_t alignment(ALIGN_WINDOW);
+int buckets(DEFAULT_BUCKETS);
+double remoteThreshold(DEFAULT_REMOTE_THRESHOLD);
+double trafficThreshold(DEFAULT_TRAFFIC_THRESHOLD);
+double sharedThreshold(DEFAULT_SHARED_THRESHOLD);
+
+
+FILE* openInput(const char* filename, char* header) {
+    FILE* input = fopen(filename, "r");
+    if (input == NULL) {
+	cerr << "Unable to open " << filename << endl;
+	exit(-1);
+    }
+    if (fgets(header, MAX_LINE, input) == NULL) {
+	cerr << filename << " is empty" << endl;
+	exit(-1);
+    }
+    return input;
+}
+
+/**
+ * Reads summarizeInterconnect output:
+ * frame sourceNode destNode reads writes
+ */
+void loadInterconnect(const char* filename, run_t* run) {
+    char line[MAX_LINE];
+    FILE* input = openInput(filename, line);
+    if (strncmp(line, "frame\tsourceNode\tdestNode", 25) != 0) {
+	cerr << filename << " is not summarizeInterconnect output. Reduce traces first, e.g." << endl;
+	cerr << "  traceDiff <(zcat before/*.gz | ./summarizeInterconnect) <(zcat after/*.gz | ./summarizeInterconnect)" << endl;
+	exit(-1);
+    }
+    struct entry_t {
+	frame_t frame;
+	int source;
+	int dest;
+	readWrite_t rw;
+    };
+    vector<entry_t> entries;
+    run->numNodes = 0;
+    while (fgets(line, MAX_LINE, input) != NULL) {
+	char* column = line;
+	entry_t entry;
+	entry.frame = strtol(column, &column, 10);
+	entry.source = strtol(column, &column, 10);
+	entry.dest = strtol(column, &column, 10);
+	entry.rw.reads = strtoull(column, &column, 10);
+	entry.rw.writes = strtoull(column, &column, 10);
+	if (entry.source < 0 || entry.dest < 0) {
+	    continue;
+	}
+	run->numNodes = max(run->numNodes, max(entry.source, entry.dest) + 1);
+	entries.push_back(entry);
+    }
+    if (ferror(input))
+	perror("Error reading input.");
+    fclose(input);
+    int n = run->numNodes;
+    for (auto& entry : entries) {
+	auto& matrix = run->traffic[entry.frame];
+	matrix.resize(n * n);
+	matrix[entry.source * n + entry.dest].reads += entry.rw.reads;
+	matrix[entry.source * n + entry.dest].writes += entry.rw.writes;
+    }
+}
+
+/**
+ * Reads pageReadWriteSummary output, with or without the Segment
+ * column. Segments of a frame are added up.
+ */
+void loadPages(const char* filename, run_t* run) {
+    char line[MAX_LINE];
+    FILE* input = openInput(filename, line);
+    if (strncmp(line, "Time Frame", 10) != 0) {
+	cerr << filename << " is not pageReadWriteSummary output" << endl;
+	exit(-1);
+    }
+    bool bySegment = strstr(line, "Segment") != NULL;
+    while (fgets(line, MAX_LINE, input) != NULL) {
+	char* column = line;
+	frame_t frame = strtol(column, &column, 10);
+	if (bySegment) {
+	    // skip the segment name
+	    column = strchr(column + 1, '\t');
+	    if (column == NULL) {
+		continue;
+	    }
+	}
+	auto& pages = run->pages[frame];
+	pages.pagesRead += strtod(column, &column);
+	pages.pagesWritten += strtod(column, &column);
+	pages.privateRead += strtod(column, &column);
+	pages.sharedRead += strtod(column, &column);
+	pages.privateWrite += strtod(column, &column);
+	pages.sharedWrite += strtod(column, &column);
+    }
+    if (ferror(input))
+	perror("Error reading input.");
+    fclose(input);
+}
+
+unsigned long long accesses(const vector<readWrite_t>& matrix, int numNodes, bool remote) {
+    unsigned long long total = 0;
+    for (int source = 0; source < numNodes; source++) {
+	for (int dest = 0; dest < numNodes; dest++) {
+	    if ((source != dest) == remote) {
+		total += matrix[source * numNodes + dest].reads + matrix[source * numNodes + dest].writes;
+	    }
+	}
+    }
+    return total;
+}
+
+/**
+ * Maps every frame of a run to its bin. With progress alignment a
+ * frame goes to the bucket its midpoint falls in, measured in memory
+ * events processed so far relative to all events of the run.
+ */
+map<frame_t, int> binFrames(const run_t& run) {
+    map<frame_t, int> bins;
+    if (alignment == ALIGN_WINDOW) {
+	for (auto& frame : run.traffic) {
+	    bins[frame.first] = frame.first;
+	}
+	for (auto& frame : run.pages) {
+	    bins[frame.first] = frame.first;
+	}
+	return bins;
+    }
+    unsigned long long total = 0;
+    for (auto& frame : run.traffic) {
+	total += accesses(frame.second, run.numNodes, false) + accesses(frame.second, run.numNodes, true);
+    }
+    unsigned long long processed = 0;
+    for (auto& frame : run.traffic) {
+	unsigned long long events = accesses(frame.second, run.numNodes, false) + accesses(frame.second, run.numNodes, true);
+	double midpoint = total ? (processed + events / 2.0) / total : 0;
+	bins[frame.first] = min((int)(midpoint * buckets), buckets - 1);
+	processed += events;
+    }
+    return bins;
+}
+
+map<int, bin_t> alignRun(const run_t& run, int numNodes) {
+    map<int, bin_t> bins;
+    map<frame_t, int> frameBins = binFrames(run);
+    for (auto& frame : run.traffic) {
+	auto& bin = bins[frameBins[frame.first]];
+	bin.traffic.resize(numNodes * numNodes);
+	for (int source = 0; source < run.numNodes; source++) {
+	    for (int dest = 0; dest < run.numNodes; dest++) {
+		auto& rw = frame.second[source * run.numNodes + dest];
+		bin.traffic[source * numNodes + dest].reads += rw.reads;
+		bin.traffic[source * numNodes + dest].writes += rw.writes;
+	    }
+	}
+    }
+    for (auto& frame : run.pages) {
+	auto it = frameBins.find(frame.first);
+	if (it == frameBins.end()) {
+	    // progress of frames without traffic is unknown
+	    continue;
+	}
+	auto& bin = bins[it->second];
+	bin.pages.pagesRead += frame.second.pagesRead;
+	bin.pages.pagesWritten += frame.second.pagesWritten;
+	bin.pages.privateRead += frame.second.privateRead;
+	bin.pages.sharedRead += frame.second.sharedRead;
+	bin.pages.privateWrite += frame.second.privateWrite;
+	bin.pages.sharedWrite += frame.second.sharedWrite;
+	bin.pageFrames++;
+    }
+    return bins;
+}
+
+/*
+ * Accumulated metrics of one bin of one run.
+ */
+struct metrics_t {
+    unsigned long long local;
+    unsigned long long remote;
+    double sharedPages;
+    double privatePages;
+};
+
+metrics_t binMetrics(const bin_t* bin, int numNodes) {
+    metrics_t metrics = {0, 0, 0, 0};
+    if (bin == NULL) {
+	return metrics;
+    }
+    if (!bin->traffic.empty()) {
+	metrics.local = accesses(bin->traffic, numNodes, false);
+	metrics.remote = accesses(bin->traffic, numNodes, true);
+    }
+    if (bin->pageFrames > 0) {
+	metrics.sharedPages = (bin->pages.sharedRead + bin->pages.sharedWrite) / bin->pageFrames;
+	metrics.privatePages = (bin->pages.privateRead + bin->pages.privateWrite) / bin->pageFrames;
+    }
+    return metrics;
+}
+
+double remoteRatio(const metrics_t& metrics) {
+    unsigned long long total = metrics.local + metrics.remote;
+    return total ? (double)metrics.remote / total : 0;
+}
+
+double relativeIncrease(double before, double after) {
+    if (before <= 0) {
+	return after > 0 ? 1 : 0;
+    }
+    return (after - before) / before;
+}
+
+/**
+ * Prints one row of the comparison.
+ * @return true if the row exceeds one of the regression thresholds
+ */
+bool printComparison(const string& label, const metrics_t& before, const metrics_t& after, bool havePages) {
+    string flags;
+    if (remoteRatio(after) - remoteRatio(before) > remoteThreshold) {
+	flags += "remoteRatio,";
+    }
+    if (relativeIncrease(before.remote, after.remote) > trafficThreshold) {
+	flags += "remoteTraffic,";
+    }
+    if (havePages && relativeIncrease(before.sharedPages, after.sharedPages) > sharedThreshold) {
+	flags += "sharedPages,";
+    }
+    cout << label << '\t' << remoteRatio(before) << '\t' << remoteRatio(after) << '\t' << remoteRatio(after) - remoteRatio(before);
+    cout << '\t' << before.remote << '\t' << after.remote << '\t' << (long long)(after.remote - before.remote);
+    if (havePages) {
+	cout << '\t' << before.sharedPages << '\t' << after.sharedPages << '\t' << after.sharedPages - before.sharedPages;
+	cout << '\t' << before.privatePages << '\t' << after.privatePages << '\t' << after.privatePages - before.privatePages;
+    }
+    if (flags.empty()) {
+	cout << '\t' << "-" << '\n';
+	return false;
+    }
+    flags.erase(flags.size() - 1);
+    cout << '\t' << flags << '\n';
+    return true;
+}
+
+void printPairs(ostream& out, const string& label, const vector<readWrite_t>* before, const vector<readWrite_t>* after, int numNodes) {
+    for (int source = 0; source < numNodes; source++) {
+	for (int dest = 0; dest < numNodes; dest++) {
+	    int i = source * numNodes + dest;
+	    unsigned long long a = (before && !before->empty()) ? (*before)[i].reads + (*before)[i].writes : 0;
+	    unsigned long long b = (after && !after->empty()) ? (*after)[i].reads + (*after)[i].writes : 0;
+	    if (a == 0 && b == 0) {
+		continue;
+	    }
+	    out << label << '\t' << source << '\t' << dest << '\t' << a << '\t' << b << '\t' << (long long)(b - a) << '\n';
+	}
+    }
+}
+
+void addTraffic(vector<readWrite_t>& total, const vector<readWrite_t>& traffic) {
+    for (uint i = 0; i < traffic.size(); i++) {
+	total[i].reads += traffic[i].reads;
+	total[i].writes += traffic[i].writes;
+    }
+}
+
+void addMetrics(metrics_t& total, const metrics_t& metrics) {
+    total.local += metrics.local;
+    total.remote += metrics.remote;
+}
+
+/**
+ * Page counts are per frame, so the total of a run is the average over
+ * the frames of that run that have page data. Runs covering a
+ * different number of frames are compared frame for frame.
+ */
+void averagePages(metrics_t& total, const map<int, bin_t>& bins) {
+    double sharedPages = 0;
+    double privatePages = 0;
+    int pageFrames = 0;
+    for (auto& bin : bins) {
+	sharedPages += bin.second.pages.sharedRead + bin.second.pages.sharedWrite;
+	privatePages += bin.second.pages.privateRead + bin.second.pages.privateWrite;
+	pageFrames += bin.second.pageFrames;
+    }
+    if (pageFrames > 0) {
+	total.sharedPages = sharedPages / pageFrames;
+	total.privatePages = privatePages / pageFrames;
+    }
+}
+
+/**
+ * Compares both runs bin by bin and in total.
+ * @return true if the totals regressed
+ */
+bool compareRuns(const run_t& before, const run_t& after, bool havePages, ostream* pairsOut) {
+    int numNodes = max(before.numNodes, after.numNodes);
+    map<int, bin_t> beforeBins = alignRun(before, numNodes);
+    map<int, bin_t> afterBins = alignRun(after, numNodes);
+    map<int, bool> binIDs;
+    for (auto& bin : beforeBins) {
+	binIDs[bin.first] = true;
+    }
+    for (auto& bin : afterBins) {
+	binIDs[bin.first] = true;
+    }
+
+    cout << (alignment == ALIGN_WINDOW ? "frame" : "progress");
+    cout << "\tbeforeRemoteRatio\tafterRemoteRatio\tdeltaRemoteRatio\tbeforeRemote\tafterRemote\tdeltaRemote";
+    if (havePages) {
+	cout << "\tbeforeShared\tafterShared\tdeltaShared\tbeforePrivate\tafterPrivate\tdeltaPrivate";
+    }
+    cout << "\tregression" << endl;
+    if (pairsOut) {
+	*pairsOut << (alignment == ALIGN_WINDOW ? "frame" : "progress") << "\tsourceNode\tdestNode\tbefore\tafter\tdelta" << endl;
+    }
+
+    metrics_t beforeTotal = {0, 0, 0, 0};
+    metrics_t afterTotal = {0, 0, 0, 0};
+    vector<readWrite_t> beforeTraffic(numNodes * numNodes);
+    vector<readWrite_t> afterTraffic(numNodes * numNodes);
+    for (auto& id : binIDs) {
+	auto b = beforeBins.find(id.first);
+	auto a = afterBins.find(id.first);
+	const bin_t* beforeBin = (b == beforeBins.end()) ? NULL : &b->second;
+	const bin_t* afterBin = (a == afterBins.end()) ? NULL : &a->second;
+	metrics_t beforeMetrics = binMetrics(beforeBin, numNodes);
+	metrics_t afterMetrics = binMetrics(afterBin, numNodes);
+	printComparison(to_string(id.first), beforeMetrics, afterMetrics, havePages);
+	addMetrics(beforeTotal, beforeMetrics);
+	addMetrics(afterTotal, afterMetrics);
+	if (beforeBin && !beforeBin->traffic.empty()) {
+	    addTraffic(beforeTraffic, beforeBin->traffic);
+	}
+	if (afterBin && !afterBin->traffic.empty()) {
+	    addTraffic(afterTraffic, afterBin->traffic);
+	}
+	if (pairsOut) {
+	    printPairs(*pairsOut, to_string(id.first), beforeBin ? &beforeBin->traffic : NULL,
+		       afterBin ? &afterBin->traffic : NULL, numNodes);
+	}
+    }
+    if (pairsOut) {
+	printPairs(*pairsOut, "total", &beforeTraffic, &afterTraffic, numNodes);
+	pairsOut->flush();
+    }
+    averagePages(beforeTotal, beforeBins);
+    averagePages(afterTotal, afterBins);
+    return printComparison("total", beforeTotal, afterTotal, havePages);
+}
+
+void usage() {
+    cerr << "usage: traceDiff [options] before after" << endl;
+    cerr << "  before, after           summarizeInterconnect output of both runs" << endl;
+    cerr << "  --pages before after    pageReadWriteSummary output of both runs" << endl;
+    cerr << "  --align window|progress align by time frame or by memory events processed, default window" << endl;
+    cerr << "  --buckets N             number of progress buckets, default " << DEFAULT_BUCKETS << endl;
+    cerr << "  --remote-threshold X    flag remote ratio increases above X, default " << DEFAULT_REMOTE_THRESHOLD << endl;
+    cerr << "  --traffic-threshold X   flag relative remote traffic increases above X, default " << DEFAULT_TRAFFIC_THRESHOLD << endl;
+    cerr << "  --shared-threshold X    flag relative shared page increases above X, default " << DEFAULT_SHARED_THRESHOLD << endl;
+    cerr << "  --pairs file            write the node to node deltas to file" << endl;
+    exit(-1);
+}
+
+int main(int argc, char* argv[]) {
+    const char* inputs[2] = {NULL, NULL};
+    const char* pageInputs[2] = {NULL, NULL};
+    int numInputs = 0;
+    ofstream pairsFile;
+    for (int arg = 1; arg < argc; arg++) {
+	if (strcmp(argv[arg], "--pages") == 0 && arg + 2 < argc) {
+	    pageInputs[0] = argv[++arg];
+	    pageInputs[1] = argv[++arg];
+	} else if (strcmp(argv[arg], "--align") == 0 && arg + 1 < argc) {
+	    arg++;
+	    if (strcmp(argv[arg], "window") == 0) {
+		alignment = ALIGN_WINDOW;
+	    } else if (strcmp(argv[arg], "progress") == 0) {
+		alignment = ALIGN_PROGRESS;
+	    } else {
+		usage();
+	    }
+	} else if (strcmp(argv[arg], "--buckets") == 0 && arg + 1 < argc) {
+	    buckets = atoi(argv[++arg]);
+	    if (buckets < 1) {
+		usage();
+	    }
+	} else if (strcmp(argv[arg], "--remote-threshold") == 0 && arg + 1 < argc) {
+	    remoteThreshold = atof(argv[++arg]);
+	} else if (strcmp(argv[arg], "--traffic-threshold") == 0 && arg + 1 < argc) {
+	    trafficThreshold = atof(argv[++arg]);
+	} else if (strcmp(argv[arg], "--shared-threshold") == 0 && arg + 1 < argc) {
+	    sharedThreshold = atof(argv[++arg]);
+	} else if (strcmp(argv[arg], "--pairs") == 0 && arg + 1 < argc) {
+	    pairsFile.open(argv[++arg]);
+	    if (!pairsFile.is_open()) {
+		cerr << "Unable to open output file " << argv[arg] << endl;
+		exit(-1);
+	    }
+	} else if (numInputs < 2 && (argv[arg][0] != '-' || argv[arg][1] == '\0')) {
+	    inputs[numInputs++] = argv[arg];
+	} else {
+	    usage();
+	}
+    }
+    if (numInputs != 2) {
+	usage();
+    }
+    run_t before;
+    run_t after;
+    loadInterconnect(inputs[0], &before);
+    loadInterconnect(inputs[1], &after);
+    bool havePages = pageInputs[0] != NULL;
+    if (havePages) {
+	loadPages(pageInputs[0], &before);
+	loadPages(pageInputs[1], &after);
+    }
+    if (compareRuns(before, after, havePages, pairsFile.is_open() ? &pairsFile : NULL)) {
+	cerr << "Regression: totals exceed the thresholds" << endl;
+	return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,32 @@
+/*
+ * traceFormat.h
+ * Record types of the trace files numatrace writes and the analysis
+ * tools read. Every line holds 4 tab separated columns; the 4th
+ * column is the number of writes of a page entry (>= 0) or one of the
+ * negative markers below.
+ *
+ * THREAD_ID	-1	-1	-1	thread line, first line of the file
+ * CPU_ID	SEC	USEC	-1	start of a time frame
+ * CPU_ID	NUMA_ID	-1	-2	topology: node of a cpu
+ * NUMA_ID	NUMA_ID	DIST	-3	topology: numa_distance between nodes
+ * SEGMENT_ID	-1	-1	-4	the following pages are in this segment
+ * SEGMENT_ID	#READS	#WRITES	-5	counted accesses without pages
+ */
+#ifndef TRACE_FORMAT_H
+#define TRACE_FORMAT_H
+
+#define CPU_NODE_RECORD -2
+#define NODE_DISTANCE_RECORD -3
+#define SEGMENT_RECORD -4
+#define SEGMENT_COUNT_RECORD -5
+
+// memory segments in the order of their ids in the trace
+#define SEGMENT_STACK 0
+#define SEGMENT_HEAP 1
+#define SEGMENT_STATIC 2
+#define SEGMENT_MMAP 3
+#define NUM_SEGMENTS 4
+
+static const char* const segmentNames[NUM_SEGMENTS] = {"stack", "heap", "static", "mmap"};
+
+#endif